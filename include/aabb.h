@@ -0,0 +1,87 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include "common.h"
+#include <utility>
+
+class aabb {
+    public:
+        aabb()
+            : minimum(infinity, infinity, infinity), maximum(-infinity, -infinity, -infinity) {}
+        aabb(const point3& a, const point3& b) : minimum(a), maximum(b) {}
+
+        point3 min() const { return minimum; }
+        point3 max() const { return maximum; }
+
+        point3 centroid() const { return 0.5 * (minimum + maximum); }
+
+        int longest_axis() const
+        {
+            auto d = maximum - minimum;
+            if (d.x() > d.y() && d.x() > d.z())
+                return 0;
+            return d.y() > d.z() ? 1 : 2;
+        }
+
+        double surface_area() const
+        {
+            auto d = maximum - minimum;
+            if (d.x() < 0)
+                return 0;
+            return 2 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+        }
+
+        void expand(const aabb& box)
+        {
+            for (int a = 0; a < 3; a++) {
+                minimum[a] = box.minimum[a] < minimum[a] ? box.minimum[a] : minimum[a];
+                maximum[a] = box.maximum[a] > maximum[a] ? box.maximum[a] : maximum[a];
+            }
+        }
+
+        void expand(const point3& p)
+        {
+            for (int a = 0; a < 3; a++) {
+                minimum[a] = p[a] < minimum[a] ? p[a] : minimum[a];
+                maximum[a] = p[a] > maximum[a] ? p[a] : maximum[a];
+            }
+        }
+
+        /* slab test against a ray with precomputed reciprocal direction */
+        inline bool hit(const point3& origin, const vec3& inv_dir, double t_min, double t_max, double& t_near) const
+        {
+            for (int a = 0; a < 3; a++) {
+                auto t0 = (minimum[a] - origin[a]) * inv_dir[a];
+                auto t1 = (maximum[a] - origin[a]) * inv_dir[a];
+                if (inv_dir[a] < 0.0)
+                    std::swap(t0, t1);
+
+                t_min = t0 > t_min ? t0 : t_min;
+                t_max = t1 < t_max ? t1 : t_max;
+                if (t_max < t_min)
+                    return false;
+            }
+
+            t_near = t_min;
+            return true;
+        }
+
+        bool hit(const ray& r, double t_min, double t_max) const
+        {
+            auto d = r.direction();
+            double t_near;
+            return hit(r.origin(), vec3(1 / d.x(), 1 / d.y(), 1 / d.z()), t_min, t_max, t_near);
+        }
+
+    public:
+        point3 minimum;
+        point3 maximum;
+};
+
+inline aabb surrounding_box(aabb box0, const aabb& box1)
+{
+    box0.expand(box1);
+    return box0;
+}
+
+#endif // AABB_H
@@ -0,0 +1,185 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "common.h"
+#include "hittable_list.h"
+#include "sphere.h"
+
+/*
+ * Keyframed camera and object motion for the multi-frame (sequence) mode.
+ * Keys are given in frame numbers and interpolated linearly; values before
+ * the first key or after the last one are held.
+ */
+
+struct camera_keyframe {
+    double frame;
+    point3 lookfrom;
+    point3 lookat;
+    double vfov;
+};
+
+struct object_keyframe {
+    double frame;
+    point3 center;
+};
+
+struct object_track {
+    sphere*                      target;
+    std::vector<object_keyframe> keys;
+};
+
+template<typename Key>
+inline void sort_keys(std::vector<Key>& keys)
+{
+    std::stable_sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) { return a.frame < b.frame; });
+}
+
+// Finds the keys around 'frame' and the blend factor between them.
+template<typename Key>
+inline double find_segment(const std::vector<Key>& keys, double frame, size_t& first)
+{
+    if (frame <= keys.front().frame) {
+        first = 0;
+        return 0;
+    }
+    if (frame >= keys.back().frame) {
+        first = keys.size() - 1;
+        return 0;
+    }
+
+    first = 0;
+    while (keys[first + 1].frame < frame)
+        first++;
+
+    return (frame - keys[first].frame) / (keys[first + 1].frame - keys[first].frame);
+}
+
+inline point3 lerp(const point3& a, const point3& b, double t)
+{
+    return (1 - t) * a + t * b;
+}
+
+struct animation {
+    std::vector<camera_keyframe> camera_keys;
+    std::vector<object_track>    objects;
+
+    camera_keyframe camera_at(double frame) const
+    {
+        size_t i;
+        double t = find_segment(camera_keys, frame, i);
+        if (t == 0)
+            return camera_keys[i];
+
+        const auto& a = camera_keys[i];
+        const auto& b = camera_keys[i + 1];
+        return {
+            frame,
+            lerp(a.lookfrom, b.lookfrom, t),
+            lerp(a.lookat, b.lookat, t),
+            (1 - t) * a.vfov + t * b.vfov
+        };
+    }
+
+    // Moves the animated objects to their position at 'frame'.
+    // Returns true if anything moved, in which case the BVH needs a refit.
+    bool apply(double frame) const
+    {
+        bool moved = false;
+        for (const auto& track : objects) {
+            size_t i;
+            double t      = find_segment(track.keys, frame, i);
+            point3 center = t == 0 ? track.keys[i].center : lerp(track.keys[i].center, track.keys[i + 1].center, t);
+
+            if ((center - track.target->center).length_squared() > 0) {
+                track.target->center = center;
+                moved = true;
+            }
+        }
+        return moved;
+    }
+};
+
+/* One full orbit of the camera around 'lookat' over the sequence. */
+inline animation turntable(const point3& lookfrom, const point3& lookat, double vfov, int frames)
+{
+    animation anim;
+
+    auto   offset = lookfrom - lookat;
+    double radius = sqrt(offset.x() * offset.x() + offset.z() * offset.z());
+    double start  = atan2(offset.z(), offset.x());
+
+    for (int f = 0; f <= frames; f++) {
+        double angle = start + 2 * pi * f / frames;
+        anim.camera_keys.push_back({
+            static_cast<double>(f),
+            lookat + point3(radius * cos(angle), offset.y(), radius * sin(angle)),
+            lookat,
+            vfov
+        });
+    }
+
+    return anim;
+}
+
+/*
+ * Reads keyframes from a text file with one key per line:
+ *   camera <frame> <from x y z> <at x y z> <vfov>
+ *   object <index into the world> <frame> <center x y z>
+ * Objects that aren't spheres can't be animated and are skipped.
+ */
+inline bool read_animation(const char* path, hittable_list& world, animation& anim)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+        return false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream in(line);
+        std::string        kind;
+        if (!(in >> kind) || kind[0] == '#')
+            continue;
+
+        if (kind == "camera") {
+            camera_keyframe key;
+            double fx, fy, fz, ax, ay, az;
+            if (in >> key.frame >> fx >> fy >> fz >> ax >> ay >> az >> key.vfov) {
+                key.lookfrom = point3(fx, fy, fz);
+                key.lookat   = point3(ax, ay, az);
+                anim.camera_keys.push_back(key);
+            }
+        } else if (kind == "object") {
+            size_t index;
+            double frame, x, y, z;
+            if (!(in >> index >> frame >> x >> y >> z) || index >= world.objects.size())
+                continue;
+
+            auto* target = dynamic_cast<sphere*>(world.objects[index].get());
+            if (!target) {
+                std::cerr << std::format("Warning: Object {} in '{}' is not a sphere, ignoring it.\n", index, path);
+                continue;
+            }
+
+            auto track = std::find_if(anim.objects.begin(), anim.objects.end(), [&](const object_track& t) {
+                return t.target == target;
+            });
+            if (track == anim.objects.end()) {
+                anim.objects.push_back({ target, {} });
+                track = anim.objects.end() - 1;
+            }
+            track->keys.push_back({ frame, point3(x, y, z) });
+        }
+    }
+
+    sort_keys(anim.camera_keys);
+    for (auto& track : anim.objects)
+        sort_keys(track.keys);
+
+    return true;
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * Bump allocator that hands out memory from big aligned blocks and frees
+ * everything at once. Used for scene primitives/materials (so building and
+ * tearing down a scene doesn't touch the heap once per object) and as
+ * per-thread scratch memory for the render loop.
+ */
+class arena {
+    public:
+        static constexpr size_t block_alignment = 64;
+
+        explicit arena(size_t block_size = 1 << 20) : block_size(block_size) {}
+        ~arena()
+        {
+            reset();
+            for (auto& b : blocks)
+                ::operator delete(b.data, std::align_val_t{ block_alignment });
+        }
+
+        arena(const arena&) = delete;
+        arena& operator=(const arena&) = delete;
+
+        void* allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+        {
+            while (current < blocks.size()) {
+                auto&  b     = blocks[current];
+                size_t start = (offset + alignment - 1) & ~(alignment - 1);
+                if (start + size <= b.size) {
+                    offset = start + size;
+                    used  += size;
+                    return b.data + start;
+                }
+
+                current++;
+                offset = 0;
+            }
+
+            // Oversized requests get a block of their own.
+            size_t size_needed = std::max(block_size, size + alignment);
+            blocks.push_back({
+                static_cast<std::byte*>(::operator new(size_needed, std::align_val_t{ block_alignment })),
+                size_needed
+            });
+            current = blocks.size() - 1;
+            offset  = 0;
+            return allocate(size, alignment);
+        }
+
+        template<typename T>
+        T* allocate_array(size_t count)
+        {
+            return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        }
+
+        // Constructs an object in the arena. Destructors, if any, run on reset().
+        template<typename T, typename... Args>
+        T* create(Args&&... args)
+        {
+            T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            if constexpr (!std::is_trivially_destructible_v<T>)
+                finalizers.push_back({ [](void* p) { static_cast<T*>(p)->~T(); }, object });
+            return object;
+        }
+
+        // Destroys everything allocated so far but keeps the blocks for reuse.
+        void reset()
+        {
+            for (auto it = finalizers.rbegin(); it != finalizers.rend(); ++it)
+                it->destroy(it->object);
+
+            finalizers.clear();
+            current = 0;
+            offset  = 0;
+            used    = 0;
+        }
+
+        size_t bytes_used() const { return used; }
+
+        size_t bytes_reserved() const
+        {
+            size_t total = 0;
+            for (auto& b : blocks)
+                total += b.size;
+            return total;
+        }
+
+    private:
+        struct block {
+            std::byte* data;
+            size_t     size;
+        };
+
+        struct finalizer {
+            void (*destroy)(void*);
+            void* object;
+        };
+
+        size_t                 block_size;
+        std::vector<block>     blocks;
+        std::vector<finalizer> finalizers;
+        size_t                 current = 0;
+        size_t                 offset  = 0;
+        size_t                 used    = 0;
+};
+
+/* Standard allocator adapter; deallocation is a no-op until the arena resets. */
+template<typename T>
+struct arena_allocator {
+    using value_type = T;
+
+    arena_allocator(arena& a) : mem(&a) {}
+
+    template<typename U>
+    arena_allocator(const arena_allocator<U>& other) : mem(other.mem) {}
+
+    T* allocate(size_t n) { return mem->allocate_array<T>(n); }
+    void deallocate(T*, size_t) {}
+
+    template<typename U>
+    bool operator==(const arena_allocator<U>& other) const { return mem == other.mem; }
+
+    arena* mem;
+};
+
+/*
+ * shared_ptr whose object and control block both live in the arena. The
+ * arena must outlive every copy of the pointer.
+ */
+template<typename T, typename... Args>
+std::shared_ptr<T> make_arena_shared(arena& mem, Args&&... args)
+{
+    return std::allocate_shared<T>(arena_allocator<T>(mem), std::forward<Args>(args)...);
+}
+
+/* Per-thread scratch memory for integrator state, reset by its user. */
+inline arena& scratch_arena()
+{
+    thread_local arena scratch(64 * 1024);
+    return scratch;
+}
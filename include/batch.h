@@ -0,0 +1,223 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "arena.h"
+#include "camera.h"
+#include "config.h"
+#include "image.h"
+#include "output_writer.h"
+#include "render.h"
+#include "thread_pool.h"
+
+/*
+ * Batch of views rendered in one run. All views share the scene, its
+ * acceleration structure and the thread pool; the rows of every view go
+ * into a single parallel loop, so the threads stay busy from the first row
+ * of the first view to the last row of the last one. A view is handed to
+ * the output writer as soon as its last row is done.
+ *
+ * Views are read from a text file, one per line:
+ *
+ *   name  kind  from x y z  at x y z  vfov  [eye distance]
+ *
+ * 'kind' is one of
+ *   perspective  one image like the normal render, focused on 'at'
+ *   stereo       a left and a right image with parallel eyes, 'eye distance'
+ *                apart (default 1/30 of the view distance)
+ *   cubemap      six square 90 degree images around 'from' (vfov is ignored)
+ *   equirect     one 2:1 panorama around 'from', 'at' in the centre
+ */
+
+struct batch_view {
+    std::string name;
+    Prefs       prefs; // resolution of this view
+    camera      cam;
+};
+
+inline void add_stereo(std::vector<batch_view>& views, const std::string& name, const Prefs& prefs,
+                       camera_params params, double eye_distance)
+{
+    auto forward = params.lookat - params.lookfrom;
+    if (eye_distance <= 0)
+        eye_distance = forward.length() / 30;
+
+    auto offset = 0.5 * eye_distance * unit_vector(cross(forward, params.vup));
+    for (double side : { -1.0, 1.0 }) {
+        camera_params eye = params;
+        eye.lookfrom = params.lookfrom + side * offset;
+        eye.lookat   = params.lookat + side * offset;
+        views.push_back({ name + (side < 0 ? "_left" : "_right"), prefs, camera(eye) });
+    }
+}
+
+inline void add_cubemap(std::vector<batch_view>& views, const std::string& name, Prefs prefs, camera_params params)
+{
+    struct face {
+        const char* suffix;
+        vec3        direction;
+        vec3        up;
+    };
+    const face faces[6] = {
+        { "_px", vec3( 1, 0, 0), vec3(0, 1,  0) },
+        { "_nx", vec3(-1, 0, 0), vec3(0, 1,  0) },
+        { "_py", vec3( 0, 1, 0), vec3(0, 0, -1) },
+        { "_ny", vec3( 0,-1, 0), vec3(0, 0,  1) },
+        { "_pz", vec3( 0, 0, 1), vec3(0, 1,  0) },
+        { "_nz", vec3( 0, 0,-1), vec3(0, 1,  0) },
+    };
+
+    prefs.image_width  = prefs.image_height;
+    prefs.aspect_ratio = 1;
+    params.vfov         = 90;
+    params.aspect_ratio = 1;
+    params.aperture     = 0;
+
+    for (const auto& f : faces) {
+        camera_params p = params;
+        p.lookat = params.lookfrom + f.direction;
+        p.vup    = f.up;
+        views.push_back({ name + f.suffix, prefs, camera(p) });
+    }
+}
+
+inline void add_equirect(std::vector<batch_view>& views, const std::string& name, Prefs prefs, camera_params params)
+{
+    prefs.image_height  = prefs.image_width / 2;
+    prefs.aspect_ratio  = 2;
+    params.aspect_ratio = 2;
+    params.vfov         = 90; // unused, but keeps the perspective setup finite
+    params.proj         = projection::equirectangular;
+    views.push_back({ name, prefs, camera(params) });
+}
+
+/* Reads the view file; 'base' provides everything a line doesn't set. */
+inline bool read_views(const char* path, const Prefs& prefs, const camera_params& base, std::vector<batch_view>& views)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+        return false;
+
+    std::string line;
+    int         number = 0;
+    while (std::getline(file, line)) {
+        number++;
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream in(line);
+        std::string        name, kind;
+        double             fx, fy, fz, ax, ay, az, vfov;
+        if (!(in >> name >> kind >> fx >> fy >> fz >> ax >> ay >> az >> vfov)) {
+            std::cerr << std::format("Warning: Skipping line {} of '{}'.\n", number, path);
+            continue;
+        }
+
+        camera_params params = base;
+        params.lookfrom   = point3(fx, fy, fz);
+        params.lookat     = point3(ax, ay, az);
+        params.vfov       = vfov;
+        params.focus_dist = (params.lookat - params.lookfrom).length();
+
+        if (kind == "perspective") {
+            views.push_back({ name, prefs, camera(params) });
+        } else if (kind == "stereo") {
+            double eye_distance = 0;
+            in >> eye_distance;
+            add_stereo(views, name, prefs, params, eye_distance);
+        } else if (kind == "cubemap") {
+            add_cubemap(views, name, prefs, params);
+        } else if (kind == "equirect") {
+            add_equirect(views, name, prefs, params);
+        } else {
+            std::cerr << std::format("Warning: Unknown view kind '{}' on line {} of '{}'.\n", kind, number, path);
+        }
+    }
+
+    return true;
+}
+
+inline void write_default_views(const char* path, const camera_params& base)
+{
+    std::ofstream file(path);
+    auto          f = base.lookfrom;
+    auto          a = base.lookat;
+
+    file << "# name  kind (perspective, stereo, cubemap, equirect)  from x y z  at x y z  vfov  [eye distance]\n";
+    file << std::format("front perspective  {} {} {}  {} {} {}  {}\n", f.x(), f.y(), f.z(), a.x(), a.y(), a.z(), base.vfov);
+    file << std::format("side perspective  {} {} {}  {} {} {}  {}\n", -f.z(), f.y(), f.x(), a.x(), a.y(), a.z(), base.vfov);
+    file << std::format("pair stereo  {} {} {}  {} {} {}  {}\n", f.x(), f.y(), f.z(), a.x(), a.y(), a.z(), base.vfov);
+    file << "env cubemap  0 2 5  0 2 0  90\n";
+    file << "pano equirect  0 2 5  0 1 0  0\n";
+}
+
+inline void render_batch(const Prefs& prefs, const hittable& world, const camera_params& base, thread_pool* pool,
+                         const std::string& path)
+{
+    std::vector<batch_view> views;
+    if (!read_views(path.c_str(), prefs, base, views)) {
+        write_default_views(path.c_str(), base);
+        std::cerr << std::format("Info: Created '{}' with example views.\n", path);
+        read_views(path.c_str(), prefs, base, views);
+    }
+
+    if (views.empty()) {
+        std::cerr << std::format("Error: No views in '{}'.\n", path);
+        return;
+    }
+
+    // One work item per row of every view.
+    struct row_ref {
+        uint32_t view;
+        int      y;
+    };
+
+    std::vector<row_ref>            rows;
+    std::vector<std::vector<color>> pixels(views.size());
+    std::vector<std::atomic<int>>   rows_left(views.size());
+    size_t                          pixel_count = 0;
+    for (uint32_t v = 0; v < views.size(); v++) {
+        const auto& p = views[v].prefs;
+        pixels[v].resize(static_cast<size_t>(p.image_width) * p.image_height);
+        rows_left[v] = p.image_height;
+        pixel_count += pixels[v].size();
+        for (int y = 0; y < p.image_height; y++)
+            rows.push_back({ v, y });
+    }
+
+    output_writer writer;
+
+    std::cerr << std::format("Info: Rendering {} views ({} pixels) from '{}'.\n", views.size(), pixel_count, path);
+    auto start = std::chrono::steady_clock::now();
+
+    parallel_for(pool, 0, rows.size(), 1, [&](size_t i) {
+        const auto& view  = views[rows[i].view];
+        const int   width = view.prefs.image_width;
+        const int   y     = rows[i].y;
+
+        auto& scratch = scratch_arena();
+        auto* row     = scratch.allocate_array<pixel_result>(width);
+        auto  smp     = make_sampler(view.prefs.sampler, view.prefs.samples_per_pixel, view.prefs.seed);
+        render_span(view.prefs, view.cam, world, 0, y, width, 0, view.prefs.samples_per_pixel, row, *smp);
+
+        color* out = pixels[rows[i].view].data() + static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; x++)
+            out[x] = row[x].beauty;
+        scratch.reset();
+
+        if (--rows_left[rows[i].view] == 0)
+            writer.write_ppm(std::move(pixels[rows[i].view]), view.prefs, view.name + ".ppm");
+    });
+
+    auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cerr << std::format(
+        "Info: Rendered {} views in {}ms ({}ms per view).\n", views.size(), time.count(), time.count() / views.size()
+    );
+
+    writer.flush();
+}
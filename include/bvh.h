@@ -0,0 +1,515 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "common.h"
+#include "hittable.h"
+#include "ray_packet.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Bounding volume hierarchy built with binned SAH. Primitive bounding,
+ * binning of large ranges and the recursive subdivision all run as tasks on
+ * the given thread pool. Nodes are allocated from one flat array (children
+ * are always adjacent), so the build output is already the traversal layout.
+ *
+ * The BVH only references the primitives; whoever owns them must keep them
+ * alive for as long as the BVH is used.
+ */
+class bvh : public hittable {
+    public:
+        bvh(const std::vector<shared_ptr<hittable>>& objects, thread_pool* pool = nullptr);
+
+        virtual bool hit(
+            const ray& r,
+            double t_min,
+            double t_max,
+            ray_hit& rec
+        ) const override;
+
+        // Hits name the primitive, which fills in the surface.
+        virtual void surface(const ray&, const ray_hit&, hit_record&) const override { assert(false); }
+
+        virtual bool bounding_box(aabb& output_box) const override;
+
+        /*
+         * Closest hits of the packet lanes in 'lanes', each searched below
+         * its own t_max. Nodes are visited once for the whole packet and only
+         * the lanes that reach a leaf test its primitives. Returns the lanes
+         * that hit something; their records are written to 'recs'.
+         */
+        ray_packet::mask hit_packet(ray_packet& packet, double t_min, ray_packet::mask lanes, ray_hit* recs) const;
+
+        // Updates the node bounds after primitives moved, keeping the topology.
+        void refit(thread_pool* pool = nullptr);
+
+        size_t node_count() const { return nodes.size(); }
+        size_t primitive_count() const { return primitives.size(); }
+
+    private:
+        struct node {
+            aabb     box;
+            uint32_t offset; // first primitive for leaves, left child otherwise
+            uint32_t count;  // 0 for interior nodes
+        };
+
+        struct build_ref {
+            aabb     box;
+            point3   centroid;
+            uint32_t prim;
+        };
+
+        struct bin {
+            aabb     box;
+            aabb     centroid_box;
+            uint32_t count = 0;
+        };
+
+        static constexpr int      bin_count          = 16;
+        static constexpr uint32_t max_leaf_size      = 4;
+        static constexpr uint32_t parallel_threshold = 16 * 1024;
+
+        /*
+         * SAH splits can be arbitrarily uneven, so below this depth nodes
+         * are split at the median instead, which needs at most 32 more
+         * levels for any primitive count. The traversal stacks hold one
+         * entry per level.
+         */
+        static constexpr int max_sah_depth = 32;
+        static constexpr int stack_depth   = 64;
+        static_assert(max_sah_depth + 32 <= stack_depth);
+
+        void build_node(uint32_t index, uint32_t begin, uint32_t end, const aabb& box, const aabb& centroid_box, int depth,
+                        task_group& group);
+        aabb range_bounds(uint32_t begin, uint32_t end, bool centroids) const;
+
+        std::vector<node>            nodes;
+        std::vector<const hittable*> primitives;
+        std::vector<const hittable*> unbounded;
+
+        // Build state
+        thread_pool*          pool = nullptr;
+        std::atomic<uint32_t> nodes_used{ 0 };
+        std::vector<build_ref> refs;
+};
+
+bvh::bvh(const std::vector<shared_ptr<hittable>>& objects, thread_pool* pool) : pool(pool)
+{
+    std::vector<const hittable*> bounded;
+    bounded.reserve(objects.size());
+    for (const auto& object : objects) {
+        aabb box;
+        if (object->bounding_box(box))
+            bounded.push_back(object.get());
+        else
+            unbounded.push_back(object.get());
+    }
+
+    const uint32_t count = static_cast<uint32_t>(bounded.size());
+    if (count == 0)
+        return;
+
+    refs.resize(count);
+    parallel_for(pool, 0, count, 4096, [&](size_t i) {
+        bounded[i]->bounding_box(refs[i].box);
+        refs[i].centroid = refs[i].box.centroid();
+        refs[i].prim     = static_cast<uint32_t>(i);
+    });
+
+    nodes.resize(2 * count - 1);
+    nodes_used = 1;
+    {
+        task_group group(pool);
+        build_node(0, 0, count, range_bounds(0, count, false), range_bounds(0, count, true), 0, group);
+        group.wait();
+    }
+    nodes.resize(nodes_used);
+
+    primitives.resize(count);
+    parallel_for(pool, 0, count, 4096, [&](size_t i) {
+        primitives[i] = bounded[refs[i].prim];
+    });
+
+    refs = {};
+}
+
+aabb bvh::range_bounds(uint32_t begin, uint32_t end, bool centroids) const
+{
+    auto bounds_of = [&](uint32_t first, uint32_t last) {
+        aabb box;
+        for (uint32_t i = first; i < last; i++) {
+            if (centroids)
+                box.expand(refs[i].centroid);
+            else
+                box.expand(refs[i].box);
+        }
+        return box;
+    };
+
+    if (!pool || end - begin < parallel_threshold)
+        return bounds_of(begin, end);
+
+    const uint32_t chunks = pool->size();
+    const uint32_t step   = (end - begin + chunks - 1) / chunks;
+    std::vector<aabb> partial(chunks);
+    {
+        task_group group(pool);
+        for (uint32_t c = 0; c < chunks; c++) {
+            uint32_t first = begin + c * step;
+            uint32_t last  = std::min(end, first + step);
+            if (first < last)
+                group.run([&, c, first, last] { partial[c] = bounds_of(first, last); });
+        }
+        group.wait();
+    }
+
+    aabb box;
+    for (auto& p : partial)
+        box.expand(p);
+    return box;
+}
+
+void bvh::build_node(uint32_t index, uint32_t begin, uint32_t end, const aabb& box, const aabb& centroid_box, int depth,
+                     task_group& group)
+{
+    node&    current = nodes[index];
+    uint32_t count   = end - begin;
+
+    current.box = box;
+
+    auto make_leaf = [&] {
+        current.offset = begin;
+        current.count  = count;
+    };
+
+    if (count <= 1) {
+        make_leaf();
+        return;
+    }
+
+    int  axis         = centroid_box.longest_axis();
+    auto axis_min     = centroid_box.min()[axis];
+    auto axis_extent  = centroid_box.max()[axis] - axis_min;
+
+    if (axis_extent <= 0 || depth >= max_sah_depth) {
+        if (count <= max_leaf_size) {
+            make_leaf();
+            return;
+        }
+
+        // All centroids coincide (any split is as good as another), or the
+        // tree got deep: halve the range at the median.
+        uint32_t mid = begin + count / 2;
+        if (axis_extent > 0) {
+            std::nth_element(refs.begin() + begin, refs.begin() + mid, refs.begin() + end, [axis](const build_ref& a, const build_ref& b) {
+                return a.centroid[axis] < b.centroid[axis];
+            });
+        }
+
+        uint32_t left = nodes_used.fetch_add(2);
+        current.offset = left;
+        current.count  = 0;
+        build_node(left, begin, mid, range_bounds(begin, mid, false), range_bounds(begin, mid, true), depth + 1, group);
+        build_node(left + 1, mid, end, range_bounds(mid, end, false), range_bounds(mid, end, true), depth + 1, group);
+        return;
+    }
+
+    auto bin_scale = bin_count / axis_extent;
+    auto bin_of    = [&](const build_ref& ref) {
+        int b = static_cast<int>((ref.centroid[axis] - axis_min) * bin_scale);
+        return std::min(b, bin_count - 1);
+    };
+
+    // Bin the primitives, in parallel chunks for the big top-level ranges.
+    bin bins[bin_count];
+    auto fill_bins = [&](bin* out, uint32_t first, uint32_t last) {
+        for (uint32_t i = first; i < last; i++) {
+            auto& b = out[bin_of(refs[i])];
+            b.count++;
+            b.box.expand(refs[i].box);
+            b.centroid_box.expand(refs[i].centroid);
+        }
+    };
+
+    if (pool && count >= parallel_threshold) {
+        const uint32_t chunks = pool->size();
+        const uint32_t step   = (count + chunks - 1) / chunks;
+        std::vector<bin> partial(static_cast<size_t>(chunks) * bin_count);
+        {
+            task_group binning(pool);
+            for (uint32_t c = 0; c < chunks; c++) {
+                uint32_t first = begin + c * step;
+                uint32_t last  = std::min(end, first + step);
+                if (first < last)
+                    binning.run([&, c, first, last] { fill_bins(&partial[c * bin_count], first, last); });
+            }
+            binning.wait();
+        }
+
+        for (uint32_t c = 0; c < chunks; c++) {
+            for (int b = 0; b < bin_count; b++) {
+                bins[b].count += partial[c * bin_count + b].count;
+                bins[b].box.expand(partial[c * bin_count + b].box);
+                bins[b].centroid_box.expand(partial[c * bin_count + b].centroid_box);
+            }
+        }
+    } else {
+        fill_bins(bins, begin, end);
+    }
+
+    // Sweep the bins from both sides to evaluate every split plane.
+    double   right_area[bin_count - 1];
+    uint32_t right_count[bin_count - 1];
+    {
+        aabb     box;
+        uint32_t sum = 0;
+        for (int b = bin_count - 1; b > 0; b--) {
+            box.expand(bins[b].box);
+            sum += bins[b].count;
+            right_area[b - 1]  = box.surface_area();
+            right_count[b - 1] = sum;
+        }
+    }
+
+    int    best_split = -1;
+    double best_cost  = infinity;
+    {
+        aabb     box;
+        uint32_t sum = 0;
+        for (int b = 0; b < bin_count - 1; b++) {
+            box.expand(bins[b].box);
+            sum += bins[b].count;
+            if (sum == 0 || right_count[b] == 0)
+                continue;
+
+            double cost = sum * box.surface_area() + right_count[b] * right_area[b];
+            if (cost < best_cost) {
+                best_cost  = cost;
+                best_split = b;
+            }
+        }
+    }
+
+    // Leaf if splitting doesn't pay off (intersection cost == traversal cost).
+    double leaf_cost = count * current.box.surface_area();
+    if (best_split < 0 || (count <= max_leaf_size && best_cost >= leaf_cost)) {
+        make_leaf();
+        return;
+    }
+
+    // Child bounds come straight from the bins, no extra pass over the range.
+    aabb left_box, left_centroids, right_box, right_centroids;
+    for (int b = 0; b < bin_count; b++) {
+        if (b <= best_split) {
+            left_box.expand(bins[b].box);
+            left_centroids.expand(bins[b].centroid_box);
+        } else {
+            right_box.expand(bins[b].box);
+            right_centroids.expand(bins[b].centroid_box);
+        }
+    }
+
+    auto it = std::partition(refs.begin() + begin, refs.begin() + end, [&](const build_ref& ref) {
+        return bin_of(ref) <= best_split;
+    });
+    uint32_t mid = static_cast<uint32_t>(it - refs.begin());
+
+    uint32_t left = nodes_used.fetch_add(2);
+    current.offset = left;
+    current.count  = 0;
+
+    if (pool && count >= parallel_threshold / 4) {
+        group.run([=, this, &group] { build_node(left, begin, mid, left_box, left_centroids, depth + 1, group); });
+        build_node(left + 1, mid, end, right_box, right_centroids, depth + 1, group);
+    } else {
+        build_node(left, begin, mid, left_box, left_centroids, depth + 1, group);
+        build_node(left + 1, mid, end, right_box, right_centroids, depth + 1, group);
+    }
+}
+
+void bvh::refit(thread_pool* pool)
+{
+    // Leaves first, in parallel...
+    parallel_for(pool, 0, nodes.size(), 4096, [&](size_t i) {
+        auto& n = nodes[i];
+        if (n.count == 0)
+            return;
+
+        n.box = aabb();
+        for (uint32_t p = n.offset; p < n.offset + n.count; p++) {
+            aabb box;
+            primitives[p]->bounding_box(box);
+            n.box.expand(box);
+        }
+    });
+
+    // ...then the interior nodes bottom-up. Children are always allocated
+    // after their parent, so a reverse sweep sees them first.
+    for (size_t i = nodes.size(); i-- > 0;) {
+        auto& n = nodes[i];
+        if (n.count == 0)
+            n.box = surrounding_box(nodes[n.offset].box, nodes[n.offset + 1].box);
+    }
+}
+
+bool bvh::hit(const ray& r, double t_min, double t_max, ray_hit& rec) const
+{
+    bool hit_anything   = false;
+    auto closest_so_far = t_max;
+
+    for (const auto* object : unbounded) {
+        if (object->hit(r, t_min, closest_so_far, rec)) {
+            hit_anything   = true;
+            closest_so_far = rec.t;
+        }
+    }
+
+    if (nodes.empty())
+        return hit_anything;
+
+    const point3 origin  = r.origin();
+    const vec3   inv_dir = r.inv_direction();
+
+    struct entry {
+        uint32_t node;
+        double   t_near;
+    };
+
+    entry  stack[stack_depth];
+    int    stack_size = 0;
+    double t_near;
+
+    if (!nodes[0].box.hit(origin, inv_dir, t_min, closest_so_far, t_near))
+        return hit_anything;
+
+    uint32_t current = 0;
+    while (true) {
+        const node& n = nodes[current];
+
+        if (n.count > 0) {
+            for (uint32_t i = n.offset; i < n.offset + n.count; i++) {
+                if (primitives[i]->hit(r, t_min, closest_so_far, rec)) {
+                    hit_anything   = true;
+                    closest_so_far = rec.t;
+                }
+            }
+        } else {
+            double t_left, t_right;
+            bool   hit_left  = nodes[n.offset].box.hit(origin, inv_dir, t_min, closest_so_far, t_left);
+            bool   hit_right = nodes[n.offset + 1].box.hit(origin, inv_dir, t_min, closest_so_far, t_right);
+
+            if (hit_left && hit_right) {
+                // Visit the nearer child first, the other one later.
+                bool left_first     = t_left <= t_right;
+                assert(stack_size < stack_depth);
+                stack[stack_size++] = left_first ? entry{ n.offset + 1, t_right } : entry{ n.offset, t_left };
+                current             = left_first ? n.offset : n.offset + 1;
+                continue;
+            }
+            if (hit_left) {
+                current = n.offset;
+                continue;
+            }
+            if (hit_right) {
+                current = n.offset + 1;
+                continue;
+            }
+        }
+
+        // Pop the next subtree that can still contain a closer hit.
+        while (stack_size > 0 && stack[stack_size - 1].t_near > closest_so_far)
+            stack_size--;
+        if (stack_size == 0)
+            break;
+        current = stack[--stack_size].node;
+    }
+
+    return hit_anything;
+}
+
+ray_packet::mask bvh::hit_packet(ray_packet& packet, double t_min, ray_packet::mask lanes, ray_hit* recs) const
+{
+    ray_packet::mask hits = 0;
+
+    auto hit_primitive = [&](const hittable* object, ray_packet::mask active) {
+        while (active) {
+            int k   = std::countr_zero(active);
+            active &= active - 1;
+            if (object->hit(packet.rays[k], t_min, packet.t_max[k], recs[k])) {
+                hits            |= 1u << k;
+                packet.t_max[k]  = recs[k].t;
+            }
+        }
+    };
+
+    for (const auto* object : unbounded)
+        hit_primitive(object, lanes);
+
+    if (nodes.empty() || !lanes)
+        return hits;
+
+    struct entry {
+        uint32_t node;
+        double   t_near;
+    };
+
+    entry  stack[stack_depth];
+    int    stack_size = 0;
+    int    first      = std::countr_zero(lanes);
+    double t_near;
+
+    if (!packet.any_hit(nodes[0].box, t_min, lanes, first, t_near))
+        return hits;
+
+    // Interior nodes are entered by the whole packet as soon as one lane
+    // hits them; only leaves work out which lanes actually reach them.
+    uint32_t current = 0;
+    while (true) {
+        const node& n = nodes[current];
+
+        if (n.count > 0) {
+            auto active = packet.hit(n.box, t_min, lanes, t_near);
+            for (uint32_t i = n.offset; active && i < n.offset + n.count; i++)
+                hit_primitive(primitives[i], active);
+        } else {
+            double t_left, t_right;
+            bool   hit_left  = packet.any_hit(nodes[n.offset].box, t_min, lanes, first, t_left);
+            bool   hit_right = packet.any_hit(nodes[n.offset + 1].box, t_min, lanes, first, t_right);
+
+            if (hit_left && hit_right) {
+                bool left_first     = t_left <= t_right;
+                assert(stack_size < stack_depth);
+                stack[stack_size++] = left_first ? entry{ n.offset + 1, t_right } : entry{ n.offset, t_left };
+                current             = left_first ? n.offset : n.offset + 1;
+                continue;
+            }
+            if (hit_left || hit_right) {
+                current = hit_left ? n.offset : n.offset + 1;
+                continue;
+            }
+        }
+
+        if (stack_size == 0)
+            break;
+        current = stack[--stack_size].node;
+    }
+
+    return hits;
+}
+
+bool bvh::bounding_box(aabb& output_box) const
+{
+    if (nodes.empty() || !unbounded.empty())
+        return false;
+
+    output_box = nodes[0].box;
+    return true;
+}
+
+#endif // BVH_H
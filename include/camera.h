@@ -2,9 +2,38 @@
 #define CAMERA_H
 
 #include "common.h"
+#include "sampler.h"
+
+enum class projection {
+    perspective,
+    equirectangular, // full sphere around 'lookfrom', 'lookat' in the image centre
+};
+
+/* Everything needed to construct a camera, so it can be stored or sent around. */
+struct camera_params {
+    point3 lookfrom;
+    point3 lookat;
+    vec3   vup;
+    double vfov;
+    double aspect_ratio;
+    double aperture;
+    double focus_dist;
+    double time0 = 0;
+    double time1 = 0;
+    projection proj = projection::perspective;
+};
 
 class camera {
     public:
+        camera(const camera_params& p)
+            : camera(p.lookfrom, p.lookat, p.vup, p.vfov, p.aspect_ratio, p.aperture, p.focus_dist, p.time0, p.time1)
+        {
+            // Panoramas have no lens, so they always take the pinhole kernels.
+            proj = p.proj;
+            if (proj == projection::equirectangular)
+                lens_radius = 0;
+        }
+
         camera(
             point3 lookfrom,
             point3 lookat,
@@ -12,7 +41,9 @@ class camera {
             double vfov,
             double aspect_ratio,
             double aperture,
-            double focus_dist
+            double focus_dist,
+            double time0 = 0,
+            double time1 = 0
         )
         {
             auto theta = degrees_to_radians(vfov);
@@ -30,19 +61,44 @@ class camera {
             lower_left_corner = origin - horizontal / 2 - vertical / 2 - focus_dist * w;
 
             lens_radius = aperture / 2;
+            shutter_open  = time0;
+            shutter_close = time1;
+        }
+
+        ray get_ray(double s, double t, sampler& smp) const
+        {
+            return sample_ray<true>(s, t, smp);
         }
 
-        ray get_ray(double s, double t) const
+        /*
+         * Without defocus the lens sample is still drawn, so that every
+         * kernel consumes the sampler's dimensions in the same order.
+         */
+        template<bool Defocus, typename Sampler>
+        ray sample_ray(double s, double t, Sampler& smp) const
         {
-            vec3 rd     = lens_radius * random_in_unit_disk();
-            vec3 offset = u * rd.x() + v * rd.y();
+            auto lens   = smp.get_2d();
+            auto time   = shutter_open + (shutter_close - shutter_open) * smp.get_1d();
+
+            if (proj == projection::equirectangular) {
+                auto phi   = (s - 0.5) * 2 * pi;
+                auto theta = (t - 0.5) * pi;
+                return ray(origin, cos(theta) * (sin(phi) * u - cos(phi) * w) + sin(theta) * v, time);
+            }
 
-            return ray(
-                origin + offset,
-                lower_left_corner + s * horizontal + t * vertical - origin - offset
-            );
+            auto target = lower_left_corner + s * horizontal + t * vertical;
+            if constexpr (Defocus) {
+                vec3 rd     = lens_radius * sample_unit_disk(lens.u, lens.v);
+                vec3 offset = u * rd.x() + v * rd.y();
+                return ray(origin + offset, target - origin - offset, time);
+            } else {
+                (void)lens;
+                return ray(origin, target - origin, time);
+            }
         }
 
+        bool has_defocus() const { return lens_radius > 0; }
+
     private:
         point3 origin;
         point3 lower_left_corner;
@@ -50,6 +106,8 @@ class camera {
         vec3   vertical;
         vec3   w, u, v;
         double lens_radius;
+        double shutter_open, shutter_close;
+        projection proj = projection::perspective;
 };
 
 #endif // CAMERA_H
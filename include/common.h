@@ -11,7 +11,7 @@ using std::make_shared;
 using std::sqrt;
 
 constexpr double infinity = std::numeric_limits<double>::infinity();
-constexpr double pi       = 1415926535897932385;
+constexpr double pi       = 3.1415926535897932385;
 
 inline double degrees_to_radians(double degrees)
 {
@@ -19,6 +19,7 @@ inline double degrees_to_radians(double degrees)
 }
 
 extern double random_double();
+extern void   seed_random(unsigned seed);
 
 inline double random_double(double min, double max)
 {
@@ -1,9 +1,15 @@
 #pragma once
+#include <algorithm> // max
+#include <cmath> // isfinite
+#include <cstdint> // int64_t
+#include <cstring> // memcpy
 #include <fstream> // ifstream
 #include <sstream> // stringstream
 #include <string_view> // string_view
 #include <iostream> // cerr
 #include <format> // format
+#include <string> // string, stoi
+#include "sampler.h"
 
 struct Prefs
 {
@@ -14,21 +20,86 @@ struct Prefs
     int max_depth;
     bool use_threading;
     int seed;
+    sampler_type sampler;
+    int frames;
+    double shutter;
+    bool denoise;
+    bool spectral;
 };
 
+inline Prefs default_prefs()
+{
+    return {
+        .aspect_ratio      = 16.0 / 9.0,
+        .image_width       = 400,
+        .image_height      = static_cast<int>(400 / (16.0 / 9.0)),
+        .samples_per_pixel = 10,
+        .max_depth         = 50,
+        .use_threading     = true,
+        .seed              = 1234,
+        .sampler           = sampler_type::sobol,
+        .frames            = 1,
+        .shutter           = 0.0,
+        .denoise           = false,
+        .spectral          = false
+    };
+}
+
+// Values added after the first release are optional so that older
+// config files keep working; a missing value keeps its default.
+template<typename T>
+inline void read_optional(std::ifstream& file, T& value)
+{
+    T tmp;
+    if (file >> tmp)
+        value = tmp;
+}
+
+inline void read_optional(std::ifstream& file, sampler_type& value)
+{
+    int tmp = static_cast<int>(value);
+    read_optional(file, tmp);
+    if (tmp >= 0 && tmp <= static_cast<int>(sampler_type::blue_noise))
+        value = static_cast<sampler_type>(tmp);
+}
+
+// Largest settings accepted from other processes (render jobs, tile jobs).
+constexpr int     max_image_side        = 16384;
+constexpr int64_t max_image_pixels      = 7680 * 4320;
+constexpr int     max_samples_per_pixel = 1 << 16;
+constexpr int     max_path_depth        = 1000;
+
+/*
+ * Checks settings that were received as raw bytes. The flags are set to
+ * 0 or 1 from whatever byte arrived, since the renderer indexes tables with
+ * them; everything else must be in range. Returns false if it isn't, and
+ * the settings mustn't be rendered then.
+ */
+inline bool validate(Prefs& prefs)
+{
+    for (bool* flag : { &prefs.use_threading, &prefs.denoise, &prefs.spectral }) {
+        unsigned char byte;
+        std::memcpy(&byte, flag, 1);
+        *flag = byte != 0;
+    }
+
+    const int sampler = static_cast<int>(prefs.sampler);
+    return sampler >= 0 && sampler <= static_cast<int>(sampler_type::blue_noise) &&
+           prefs.image_width > 0 && prefs.image_width <= max_image_side &&
+           prefs.image_height > 0 && prefs.image_height <= max_image_side &&
+           static_cast<int64_t>(prefs.image_width) * prefs.image_height <= max_image_pixels &&
+           prefs.samples_per_pixel > 0 && prefs.samples_per_pixel <= max_samples_per_pixel &&
+           prefs.max_depth >= 0 && prefs.max_depth <= max_path_depth &&
+           prefs.frames >= 1 &&
+           std::isfinite(prefs.aspect_ratio) && prefs.aspect_ratio > 0 &&
+           std::isfinite(prefs.shutter) && prefs.shutter >= 0 && prefs.shutter <= 1;
+}
+
 inline Prefs read_from_file(const char* path)
 {
     std::ifstream file(path);
     if (!file.is_open()) {
-        Prefs defaultVals = {
-            .aspect_ratio      = 16.0 / 9.0,
-            .image_width       = 400,
-            .image_height      = static_cast<int>(400 / (16.0 / 9.0)),
-            .samples_per_pixel = 10,
-            .max_depth         = 50,
-            .use_threading     = true,
-            .seed              = 1234
-        };
+        Prefs defaultVals = default_prefs();
 
         std::cerr << std::format("Info: Couldn't get preferences from file '{}'. Using default values.\n", path);
 
@@ -40,10 +111,20 @@ inline Prefs read_from_file(const char* path)
             save << std::format("{}\n", defaultVals.max_depth);
             save << std::format("{}\n", (int)defaultVals.use_threading);
             save << std::format("{}\n", defaultVals.seed);
+            save << std::format("{}\n", (int)defaultVals.sampler);
+            save << std::format("{}\n", defaultVals.frames);
+            save << std::format("{}\n", defaultVals.shutter);
+            save << std::format("{}\n", (int)defaultVals.denoise);
+            save << std::format("{}\n", (int)defaultVals.spectral);
 
             save << "|--- What the values are:\n";
             save << "1. aspect ratio (default is 16:9)\n2. image width\n3. samples per pixel\n";
             save << "4. max depth\n5. use threading\n6. world seed\n";
+            save << "7. sampler (0 = independent, 1 = stratified, 2 = sobol, 3 = blue noise)\n";
+            save << "8. frames (more than 1 renders a sequence, see keyframes.cfg)\n";
+            save << "9. shutter interval for motion blur (0 = off, 1 = whole motion)\n";
+            save << "10. denoise (also writes the albedo and normal AOVs)\n";
+            save << "11. spectral rendering (dispersion in glass)\n";
 
             std::cerr << std::format("Info: Created file '{}' with default settings.\n", path);
         } else {
@@ -53,15 +134,206 @@ inline Prefs read_from_file(const char* path)
         return defaultVals;
     }
 
-    Prefs prefs = {};
+    Prefs prefs = default_prefs();
     file >> prefs.aspect_ratio;
     file >> prefs.image_width;
     file >> prefs.samples_per_pixel;
     file >> prefs.max_depth;
     file >> prefs.use_threading;
     file >> prefs.seed;
+    read_optional(file, prefs.sampler);
+    read_optional(file, prefs.frames);
+    read_optional(file, prefs.shutter);
+    read_optional(file, prefs.denoise);
+    read_optional(file, prefs.spectral);
     file.close();
 
     prefs.image_height = static_cast<int>(prefs.image_width / prefs.aspect_ratio);
     return prefs;
 }
+
+enum class run_mode
+{
+    render,
+    coordinator,
+    worker,
+    server,
+    submit,
+    preview,
+    batch,
+    write_scene,
+    perf_check,
+    usage,
+};
+
+enum class accel_type
+{
+    automatic,
+    bvh,
+    grid,
+};
+
+/* Crop window in image coordinates: x from the left, y from the top. */
+struct crop_window
+{
+    int x = 0, y = 0, width = 0, height = 0;
+
+    bool empty() const { return width <= 0 || height <= 0; }
+};
+
+// Command line options. Render settings live in the config file, these
+// only decide what this process does.
+struct Args
+{
+    run_mode mode = run_mode::render;
+    std::string host = "127.0.0.1";
+    int port = 7733;
+    int tile_size = 32;
+    int tile_timeout = 120; // seconds a worker may take for one tile
+    int cache_size = 4; // scenes the render server keeps built
+    std::string output = "preview";
+    std::string preview_path = "preview.ppm";
+    std::string views_path = "views.cfg";
+    std::string scene_path; // render this scene file instead of building the scene
+    std::string write_scene_path;
+    int scene_extent = 30; // the random scene spans [-extent, extent) on both axes
+    int resident_mb = 512; // memory for scene file chunks
+    accel_type accel = accel_type::automatic;
+    std::string accum_path; // accumulation file that region renders merge into
+    crop_window crop;
+    std::string mask_path;
+    double time_budget = 0; // seconds per frame, 0 renders all samples
+    int perf_runs = 10; // timed runs per case of the performance check
+    bool perf_update = false; // replace the stored performance baseline and reference images
+    std::string perf_refs = "perf"; // directory of the performance check's reference images
+};
+
+inline void print_usage(const char* program)
+{
+    std::cerr << std::format(
+        "Usage: {} [options]\n"
+        "  (no options)             render using the settings in prefs.cfg\n"
+        "  --coordinator [port]     split frames into tiles and hand them to workers\n"
+        "  --worker [host:port]     render tiles for a coordinator\n"
+        "  --tile-size <pixels>     tile edge length used by the coordinator\n"
+        "  --tile-timeout <seconds> time a worker gets per tile before it is retried elsewhere\n"
+        "  --server [port]          keep running and render jobs sent with --submit\n"
+        "  --submit [host:port]     send prefs.cfg as a job to a render server\n"
+        "  --output <name>          file name (without .ppm) for a submitted job\n"
+        "  --cache-size <scenes>    number of built scenes the server keeps\n"
+        "  --preview [file]         render passes into a mapped image, following view.cfg\n"
+        "  --views [file]           render every view listed in the file (default views.cfg)\n"
+        "  --write-scene <file> [extent]  build the random scene and save it as a scene file\n"
+        "  --scene <file>           stream the scene from a scene file instead of building it\n"
+        "  --resident-mb <MiB>      memory the scene file chunks may occupy\n"
+        "  --accel <bvh|grid|auto>  acceleration structure (auto picks by scene)\n"
+        "  --accumulate <file>      add the samples to an accumulation file and write the merged image\n"
+        "  --crop <x> <y> <w> <h>   render only this window (from the top left), see --accumulate\n"
+        "  --mask <file>            render only the pixels that aren't black in this PGM/PPM image\n"
+        "  --time-budget <seconds>  take whole passes until the time is up (spp becomes the limit)\n"
+        "  --perf-check [runs]      time fixed reference renders against perf_baseline.cfg\n"
+        "  --perf-update            like --perf-check, but store the results as the new baseline and references\n"
+        "  --perf-refs <dir>        directory of the reference images for --perf-check (default perf)\n",
+        program
+    );
+}
+
+inline Args parse_args(int argc, char** argv)
+{
+    Args args;
+
+    auto has_value = [&](int i) { return i + 1 < argc && argv[i + 1][0] != '-'; };
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string_view arg = argv[i];
+
+            if (arg == "--coordinator") {
+                args.mode = run_mode::coordinator;
+                if (has_value(i))
+                    args.port = std::stoi(argv[++i]);
+            } else if (arg == "--server") {
+                args.mode = run_mode::server;
+                if (has_value(i))
+                    args.port = std::stoi(argv[++i]);
+            } else if (arg == "--worker" || arg == "--submit") {
+                args.mode = arg == "--worker" ? run_mode::worker : run_mode::submit;
+                if (has_value(i)) {
+                    std::string address = argv[++i];
+                    auto colon = address.rfind(':');
+                    if (colon != std::string::npos) {
+                        args.port = std::stoi(address.substr(colon + 1));
+                        address   = address.substr(0, colon);
+                    }
+                    if (!address.empty())
+                        args.host = address;
+                }
+            } else if (arg == "--tile-size" && has_value(i)) {
+                args.tile_size = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--tile-timeout" && has_value(i)) {
+                args.tile_timeout = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--preview") {
+                args.mode = run_mode::preview;
+                if (has_value(i))
+                    args.preview_path = argv[++i];
+            } else if (arg == "--views") {
+                args.mode = run_mode::batch;
+                if (has_value(i))
+                    args.views_path = argv[++i];
+            } else if (arg == "--output" && i + 1 < argc) {
+                args.output = argv[++i];
+            } else if (arg == "--cache-size" && has_value(i)) {
+                args.cache_size = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--write-scene" && has_value(i)) {
+                args.mode             = run_mode::write_scene;
+                args.write_scene_path = argv[++i];
+                if (has_value(i))
+                    args.scene_extent = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--scene" && has_value(i)) {
+                args.scene_path = argv[++i];
+            } else if (arg == "--resident-mb" && has_value(i)) {
+                args.resident_mb = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--accel" && has_value(i)) {
+                std::string_view type = argv[++i];
+                if (type == "bvh")
+                    args.accel = accel_type::bvh;
+                else if (type == "grid")
+                    args.accel = accel_type::grid;
+                else if (type == "auto")
+                    args.accel = accel_type::automatic;
+                else {
+                    std::cerr << std::format("Error: Unknown acceleration structure '{}'.\n", type);
+                    args.mode = run_mode::usage;
+                }
+            } else if (arg == "--accumulate" && has_value(i)) {
+                args.accum_path = argv[++i];
+            } else if (arg == "--crop" && i + 4 < argc) {
+                args.crop.x      = std::stoi(argv[++i]);
+                args.crop.y      = std::stoi(argv[++i]);
+                args.crop.width  = std::stoi(argv[++i]);
+                args.crop.height = std::stoi(argv[++i]);
+            } else if (arg == "--mask" && has_value(i)) {
+                args.mask_path = argv[++i];
+            } else if (arg == "--time-budget" && has_value(i)) {
+                args.time_budget = std::max(0.0, std::stod(argv[++i]));
+            } else if (arg == "--perf-check" || arg == "--perf-update") {
+                args.mode        = run_mode::perf_check;
+                args.perf_update = args.perf_update || arg == "--perf-update";
+                if (has_value(i))
+                    args.perf_runs = std::max(2, std::stoi(argv[++i]));
+            } else if (arg == "--perf-refs" && has_value(i)) {
+                args.perf_refs = argv[++i];
+            } else if (arg == "--help" || arg == "-h") {
+                args.mode = run_mode::usage;
+            } else {
+                std::cerr << std::format("Error: Unknown option '{}'.\n", arg);
+                args.mode = run_mode::usage;
+            }
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Error: Expected a number.\n";
+        args.mode = run_mode::usage;
+    }
+
+    return args;
+}
@@ -0,0 +1,191 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+#include "common.h"
+#include "thread_pool.h"
+
+/*
+ * Edge-avoiding A-Trous wavelet denoiser (Dammertz et al. 2010) guided by
+ * the first-hit albedo and normal buffers. The radiance is divided by the
+ * albedo before filtering so texture detail isn't blurred away, then five
+ * passes of a 5x5 B-spline kernel with growing holes are applied.
+ *
+ * Images are kept as separate float planes and every pass is written as
+ * plain loops over a row, so the compiler can vectorize the weight
+ * computation (its exp is evaluated with exp_neg() below, which unlike
+ * std::exp needs no library call); rows are spread across the thread pool.
+ */
+
+/*
+ * e^x for x <= 0 as 2^i * 2^f, i the integer part of x * log2(e) and 2^f
+ * from its Taylor series, to within 5e-6 relative error. Results below
+ * 2^-100 are zero, which keeps the filter sums clear of slow denormals.
+ * Only arithmetic, conversions and integer selects, so loops calling it
+ * vectorize; even the clamp of the argument goes through the bits of the
+ * float, since a float comparison keeps GCC from vectorizing without
+ * -ffast-math.
+ */
+inline float exp_neg(float x)
+{
+    uint32_t bits = std::min(std::bit_cast<uint32_t>(x), std::bit_cast<uint32_t>(-87.0f)); // also catches NaN
+    float    t    = std::bit_cast<float>(bits) * 1.44269504f;
+    int      i    = static_cast<int>(t); // rounds towards zero, so f is in (-1, 0]
+    float    f    = (t - static_cast<float>(i)) * 0.69314718f;
+
+    float    p     = 1.0f + f * (1.0f + f * (1.0f / 2 + f * (1.0f / 6 + f * (1.0f / 24 + f * (1.0f / 120 + f * (1.0f / 720 + f * (1.0f / 5040)))))));
+    int      e     = i + 127;
+    uint32_t scale = e > 27 ? static_cast<uint32_t>(e) << 23 : 0;
+    return p * std::bit_cast<float>(scale);
+}
+
+struct denoise_settings {
+    int   iterations   = 5;
+    float sigma_color  = 0.3f;
+    float sigma_normal = 0.3f;
+    float sigma_albedo = 0.2f;
+};
+
+class denoiser {
+    public:
+        denoiser(int width, int height) : width(width), height(height)
+        {
+            size_t count = static_cast<size_t>(width) * height;
+            for (auto* plane : { &color_planes, &normal_planes, &albedo_planes, &scratch_planes })
+                for (auto& p : *plane)
+                    p.resize(count);
+        }
+
+        /*
+         * All buffers hold per-pixel sums over 'samples' samples, which is how
+         * the renderer accumulates them. The result replaces 'beauty' and keeps
+         * the same scale.
+         */
+        void run(color* beauty, const color* albedo, const vec3* normal, int samples,
+                 thread_pool* pool, const denoise_settings& settings = {})
+        {
+            const size_t count = static_cast<size_t>(width) * height;
+            const float  scale = 1.0f / samples;
+
+            parallel_for(pool, 0, count, 16 * 1024, [&](size_t i) {
+                for (int c = 0; c < 3; c++) {
+                    float a = static_cast<float>(albedo[i][c]) * scale;
+                    albedo_planes[c][i] = a;
+                    normal_planes[c][i] = static_cast<float>(normal[i][c]) * scale;
+                    color_planes[c][i]  = static_cast<float>(beauty[i][c]) * scale / std::max(a, 1e-3f);
+                }
+            });
+
+            for (int pass = 0; pass < settings.iterations; pass++) {
+                const int   step        = 1 << pass;
+                const float sigma_color = settings.sigma_color / static_cast<float>(1 << pass);
+
+                parallel_for(pool, 0, height, 4, [&](size_t y) {
+                    filter_row(static_cast<int>(y), step, sigma_color, settings);
+                });
+                std::swap(color_planes, scratch_planes);
+            }
+
+            parallel_for(pool, 0, count, 16 * 1024, [&](size_t i) {
+                beauty[i] = color(
+                    color_planes[0][i] * std::max(albedo_planes[0][i], 1e-3f),
+                    color_planes[1][i] * std::max(albedo_planes[1][i], 1e-3f),
+                    color_planes[2][i] * std::max(albedo_planes[2][i], 1e-3f)
+                ) * static_cast<double>(samples);
+            });
+        }
+
+    private:
+        using planes = std::vector<float>[3];
+
+        // Pixels per block of a row; its sums live on the stack.
+        static constexpr int tile_width = 64;
+
+        void filter_row(int y, int step, float sigma_color, const denoise_settings& settings)
+        {
+            static constexpr float kernel[5] = { 1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16 };
+
+            const float inv_color  = 1.0f / (sigma_color * sigma_color);
+            const float inv_normal = 1.0f / (settings.sigma_normal * settings.sigma_normal);
+            const float inv_albedo = 1.0f / (settings.sigma_albedo * settings.sigma_albedo);
+
+            const size_t row = static_cast<size_t>(y) * width;
+            const float* cr  = color_planes[0].data() + row;
+            const float* cg  = color_planes[1].data() + row;
+            const float* cb  = color_planes[2].data() + row;
+            const float* nx  = normal_planes[0].data() + row;
+            const float* ny  = normal_planes[1].data() + row;
+            const float* nz  = normal_planes[2].data() + row;
+            const float* ar  = albedo_planes[0].data() + row;
+            const float* ag  = albedo_planes[1].data() + row;
+            const float* ab  = albedo_planes[2].data() + row;
+
+            float* out_r = scratch_planes[0].data() + row;
+            float* out_g = scratch_planes[1].data() + row;
+            float* out_b = scratch_planes[2].data() + row;
+
+            // The row goes in tiles: sums in local arrays can't alias the
+            // planes, so the compiler needs no overlap checks to vectorize.
+            for (int tx = 0; tx < width; tx += tile_width) {
+                const int tend = std::min(width, tx + tile_width);
+
+                float sum_r[tile_width] = {}, sum_g[tile_width] = {}, sum_b[tile_width] = {}, sum_w[tile_width] = {};
+
+                for (int ky = -2; ky <= 2; ky++) {
+                    int qy = y + ky * step;
+                    if (qy < 0 || qy >= height)
+                        continue;
+
+                    for (int kx = -2; kx <= 2; kx++) {
+                        const int   offset = kx * step;
+                        const int   x0     = std::max(tx, -offset);
+                        const int   x1     = std::min(tend, width - offset);
+                        const float h      = kernel[ky + 2] * kernel[kx + 2];
+
+                        // Taps are read as q[x + offset] with x limited to [x0, x1).
+                        const size_t qrow = static_cast<size_t>(qy) * width;
+                        const float* qcr  = color_planes[0].data() + qrow;
+                        const float* qcg  = color_planes[1].data() + qrow;
+                        const float* qcb  = color_planes[2].data() + qrow;
+                        const float* qnx  = normal_planes[0].data() + qrow;
+                        const float* qny  = normal_planes[1].data() + qrow;
+                        const float* qnz  = normal_planes[2].data() + qrow;
+                        const float* qar  = albedo_planes[0].data() + qrow;
+                        const float* qag  = albedo_planes[1].data() + qrow;
+                        const float* qab  = albedo_planes[2].data() + qrow;
+
+                        for (int x = x0; x < x1; x++) {
+                            float dc = (cr[x] - qcr[x + offset]) * (cr[x] - qcr[x + offset])
+                                     + (cg[x] - qcg[x + offset]) * (cg[x] - qcg[x + offset])
+                                     + (cb[x] - qcb[x + offset]) * (cb[x] - qcb[x + offset]);
+                            float dn = (nx[x] - qnx[x + offset]) * (nx[x] - qnx[x + offset])
+                                     + (ny[x] - qny[x + offset]) * (ny[x] - qny[x + offset])
+                                     + (nz[x] - qnz[x + offset]) * (nz[x] - qnz[x + offset]);
+                            float da = (ar[x] - qar[x + offset]) * (ar[x] - qar[x + offset])
+                                     + (ag[x] - qag[x + offset]) * (ag[x] - qag[x + offset])
+                                     + (ab[x] - qab[x + offset]) * (ab[x] - qab[x + offset]);
+
+                            float w = h * exp_neg(-(dc * inv_color + dn * inv_normal + da * inv_albedo));
+
+                            sum_r[x - tx] += w * qcr[x + offset];
+                            sum_g[x - tx] += w * qcg[x + offset];
+                            sum_b[x - tx] += w * qcb[x + offset];
+                            sum_w[x - tx] += w;
+                        }
+                    }
+                }
+
+                for (int x = tx; x < tend; x++) {
+                    // The center tap always contributes, so sum_w > 0.
+                    float inv = 1.0f / sum_w[x - tx];
+                    out_r[x] = sum_r[x - tx] * inv;
+                    out_g[x] = sum_g[x - tx] * inv;
+                    out_b[x] = sum_b[x - tx] * inv;
+                }
+            }
+        }
+
+        int    width, height;
+        planes color_planes, normal_planes, albedo_planes, scratch_planes;
+};
@@ -0,0 +1,297 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "bvh.h"
+#include "camera.h"
+#include "config.h"
+#include "net.h"
+#include "render.h"
+#include "scene_cache.h"
+#include "thread_pool.h"
+
+/*
+ * Tile rendering across processes. The coordinator splits the frame into
+ * tiles and hands them out over TCP to any number of workers, which build
+ * the same scene from the seed, render the tiles they are given and send
+ * back the per-pixel sums. A tile whose worker disconnects or times out
+ * goes back into the queue and is handed to the next free worker.
+ *
+ * Every message starts with a message id:
+ *   worker -> coordinator: hello(magic), result(tile, pixels)
+ *   coordinator -> worker: job(prefs, camera), tile(tile), done
+ */
+namespace distributed {
+
+constexpr uint32_t protocol_magic = 0x31545253; // "SRT1"
+
+enum class message : uint32_t {
+    hello  = 1,
+    job    = 2,
+    tile   = 3,
+    result = 4,
+    done   = 5,
+};
+
+// Largest payloads each message can have, so a peer can't make us allocate more.
+constexpr uint64_t hello_size = 2 * sizeof(uint32_t);
+constexpr uint64_t job_size   = sizeof(uint32_t) + sizeof(Prefs) + sizeof(camera_params);
+constexpr uint64_t tile_size  = sizeof(uint32_t) + sizeof(tile);
+
+inline uint64_t result_size(const tile& t)
+{
+    return sizeof(uint32_t) + sizeof(tile) + static_cast<uint64_t>(t.pixel_count()) * sizeof(pixel_result);
+}
+
+/* True if 't' is a non-empty tile inside the image described by 'prefs'. */
+inline bool inside_image(const tile& t, const Prefs& prefs)
+{
+    return t.x0 >= 0 && t.y0 >= 0 && t.x0 < t.x1 && t.y0 < t.y1 && t.x1 <= prefs.image_width &&
+           t.y1 <= prefs.image_height;
+}
+
+inline std::vector<tile> split_into_tiles(int width, int height, int size)
+{
+    std::vector<tile> tiles;
+    for (int y = 0; y < height; y += size)
+        for (int x = 0; x < width; x += size)
+            tiles.push_back({ x, y, std::min(x + size, width), std::min(y + size, height) });
+    return tiles;
+}
+
+using merge_fn = std::function<void(const tile&, const pixel_result*)>;
+
+/*
+ * Blocks until every tile of the frame has been rendered by some worker.
+ * 'merge' is called once per finished tile, never concurrently.
+ */
+inline bool run_coordinator(const Prefs& prefs, const camera_params& cam, const Args& args, const merge_fn& merge)
+{
+    if (Prefs checked = prefs; !validate(checked)) {
+        std::cerr << "Error: These settings are outside what workers accept.\n";
+        return false;
+    }
+
+    auto listener = net::listen(args.port);
+    if (!listener.valid()) {
+        std::cerr << std::format("Error: Couldn't listen on port {}.\n", args.port);
+        return false;
+    }
+
+    auto tiles = split_into_tiles(prefs.image_width, prefs.image_height, args.tile_size);
+
+    std::mutex              stateMutex;
+    std::condition_variable stateChanged;
+    std::deque<tile>        pending(tiles.begin(), tiles.end());
+    size_t                  completed = 0;
+    int                     workers   = 0;
+    std::mutex              mergeMutex;
+
+    auto serve = [&](net::socket s) {
+        s.set_timeout(args.tile_timeout * 1000);
+
+        std::vector<char> payload;
+        uint32_t          kind = 0, magic = 0;
+        if (!s.recv_message(payload, hello_size) || !(net::reader(payload) >> kind >> magic).ok() ||
+            kind != static_cast<uint32_t>(message::hello) || magic != protocol_magic) {
+            std::cerr << "\nWarning: Rejected a connection that isn't a SoftwareRT worker.\n";
+            return;
+        }
+
+        net::writer job;
+        job << static_cast<uint32_t>(message::job) << prefs << cam;
+        if (!s.send_message(job.data))
+            return;
+
+        {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            workers++;
+        }
+
+        std::vector<pixel_result> pixels;
+        while (true) {
+            tile t;
+            {
+                std::unique_lock<std::mutex> lock(stateMutex);
+                stateChanged.wait(lock, [&] { return !pending.empty() || completed == tiles.size(); });
+                if (pending.empty())
+                    break;
+                t = pending.front();
+                pending.pop_front();
+            }
+
+            net::writer request;
+            request << static_cast<uint32_t>(message::tile) << t;
+
+            bool ok = s.send_message(request.data) && s.recv_message(payload, result_size(t));
+            if (ok) {
+                net::reader result(payload);
+                tile        echo;
+                result >> kind >> echo;
+
+                pixels.resize(t.pixel_count());
+                result.read(pixels.data(), pixels.size() * sizeof(pixel_result));
+
+                ok = result.ok() && kind == static_cast<uint32_t>(message::result) &&
+                     echo.x0 == t.x0 && echo.y0 == t.y0 && echo.x1 == t.x1 && echo.y1 == t.y1;
+            }
+
+            if (!ok) {
+                // Give the tile to someone else and drop this worker.
+                std::cerr << std::format("\nWarning: Lost a worker, retrying tile at ({}, {}).\n", t.x0, t.y0);
+                {
+                    std::unique_lock<std::mutex> lock(stateMutex);
+                    pending.push_front(t);
+                    workers--;
+                }
+                stateChanged.notify_all();
+                return;
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(mergeMutex);
+                merge(t, pixels.data());
+            }
+            {
+                std::unique_lock<std::mutex> lock(stateMutex);
+                completed++;
+            }
+            stateChanged.notify_all();
+        }
+
+        net::writer done;
+        done << static_cast<uint32_t>(message::done);
+        s.send_message(done.data);
+
+        std::unique_lock<std::mutex> lock(stateMutex);
+        workers--;
+    };
+
+    std::cerr << std::format("Info: Waiting for workers on port {} ({} tiles).\n", args.port, tiles.size());
+
+    std::vector<std::thread> handlers;
+    std::thread acceptor([&] {
+        while (true) {
+            auto s = net::accept(listener);
+            if (!s.valid())
+                return;
+
+            std::unique_lock<std::mutex> lock(stateMutex);
+            if (completed == tiles.size())
+                return;
+            handlers.emplace_back(serve, std::move(s));
+        }
+    });
+
+    {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        while (completed < tiles.size()) {
+            stateChanged.wait_for(lock, std::chrono::milliseconds(250));
+            std::cerr << std::format("\rTiles remaining: {} ({} workers) ", tiles.size() - completed, workers);
+            std::cerr << std::flush;
+        }
+    }
+    stateChanged.notify_all();
+
+    listener.shutdown();
+    acceptor.join();
+    listener.close();
+
+    for (auto& handler : handlers)
+        handler.join();
+
+    std::cerr << "\n";
+    return true;
+}
+
+/*
+ * Connects to the coordinator and renders tiles until it says the frame is
+ * done, then reconnects for the next frame. The scene is kept between
+ * frames as long as the seed and motion blur setting stay the same. Gives up once no
+ * coordinator has been reachable for a few seconds.
+ */
+inline int run_worker(const Args& args)
+{
+    const unsigned threadCount = std::thread::hardware_concurrency();
+    thread_pool    pool(threadCount);
+
+    scene_cache scenes(1);
+    size_t      built = 0;
+
+    std::cerr << std::format("Info: Worker using {} threads, connecting to {}:{}.\n", threadCount, args.host, args.port);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (std::chrono::steady_clock::now() < deadline) {
+        auto s = net::connect(args.host, args.port);
+        if (!s.valid()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            continue;
+        }
+
+        net::writer hello;
+        hello << static_cast<uint32_t>(message::hello) << protocol_magic;
+
+        std::vector<char> payload;
+        uint32_t          kind = 0;
+        Prefs             prefs;
+        camera_params     params;
+        if (!s.send_message(hello.data) || !s.recv_message(payload, job_size) ||
+            !(net::reader(payload) >> kind >> prefs >> params).ok() || kind != static_cast<uint32_t>(message::job)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            continue;
+        }
+        if (!validate(prefs)) {
+            std::cerr << "Warning: Rejected a job with invalid settings from the coordinator.\n";
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            continue;
+        }
+
+        auto scene = scenes.get({ prefs.seed, prefs.shutter > 0 }, &pool);
+        if (scenes.misses() > built) {
+            built = scenes.misses();
+            std::cerr << std::format("Info: Built scene with {} primitives.\n", scene->accel->primitive_count());
+        }
+
+        camera                    cam(params);
+        std::vector<pixel_result> pixels;
+        int                       rendered = 0;
+
+        while (s.recv_message(payload, tile_size)) {
+            net::reader request(payload);
+            tile        t;
+            request >> kind;
+            if (!request.ok() || kind != static_cast<uint32_t>(message::tile))
+                break;
+            request >> t;
+            if (!request.ok() || !inside_image(t, prefs))
+                break;
+
+            pixels.resize(t.pixel_count());
+            render_tile(prefs, cam, *scene->accel, t, pixels.data(), &pool);
+
+            net::writer result;
+            result << static_cast<uint32_t>(message::result) << t;
+            result.write(pixels.data(), pixels.size() * sizeof(pixel_result));
+            if (!s.send_message(result.data))
+                break;
+            rendered++;
+        }
+
+        std::cerr << std::format("Info: Rendered {} tiles for the coordinator.\n", rendered);
+        deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    }
+
+    std::cerr << "Info: No coordinator left, exiting.\n";
+    return 0;
+}
+
+} // namespace distributed
@@ -2,15 +2,35 @@
 #define HITTABLE_H
 
 #include "common.h"
+#include "aabb.h"
+
+#include <cstdint>
 
 class material;
+class hittable;
+
+/*
+ * What intersection keeps about the closest hit so far. It is rewritten for
+ * every closer candidate, so it holds only the distance and who was hit;
+ * the surface is worked out once, for the final hit, by surface().
+ */
+struct ray_hit {
+    double          t;
+    const hittable* object; // the primitive hit
+    uint32_t        group;  // for objects made of many parts: the group
+    uint32_t        index;  // and the element in it that was hit
+};
 
+/* Surface at a hit, as the materials need it. */
 struct hit_record {
-    point3 point;
-    vec3   normal;
-    shared_ptr<material> mat_ptr;
-    double t;
-    bool   front_face;
+    point3          point;
+    vec3            normal;
+    const material* mat_ptr;
+    double          t;
+    bool            front_face;
+
+    // Keeps streamed scene data (the material) alive while the hit is shaded.
+    shared_ptr<const void> owner;
 
     inline void set_face_normal(const ray& r, const vec3& outward_normal)
     {
@@ -27,8 +47,16 @@ class hittable {
             const ray& r, 
             double t_min, 
             double t_max, 
-            hit_record& rec
+            ray_hit& rec
         ) const = 0;
+
+        /*
+         * Fills 'rec' for a hit this object reported. Aggregates pass on the
+         * hits of their primitives, so they are never asked.
+         */
+        virtual void surface(const ray& r, const ray_hit& h, hit_record& rec) const = 0;
+
+        virtual bool bounding_box(aabb& output_box) const = 0;
 };
 
 #endif // HITTABLE_H
@@ -2,6 +2,7 @@
 #define HITTABLE_LIST_H
 
 #include "hittable.h"
+#include <cassert>
 #include <memory>
 #include <vector>
 
@@ -14,34 +15,56 @@ class hittable_list : public hittable {
         hittable_list(shared_ptr<hittable> object) { add(object); }
 
         void clear() { objects.clear(); }
+        void reserve(size_t count) { objects.reserve(count); }
         void add(shared_ptr<hittable> object) { objects.push_back(object); }
 
         virtual bool hit(
             const ray& r,
             double t_min,
             double t_max,
-            hit_record& rec
+            ray_hit& rec
         ) const override;
 
+        // Hits name the primitive, which fills in the surface.
+        virtual void surface(const ray&, const ray_hit&, hit_record&) const override { assert(false); }
+
+        virtual bool bounding_box(aabb& output_box) const override;
+
     public:
         std::vector<shared_ptr<hittable>> objects;
 };
 
-bool hittable_list::hit(const ray& r, double t_min, double t_max, hit_record& rec) const
+bool hittable_list::hit(const ray& r, double t_min, double t_max, ray_hit& rec) const
 {
-    hit_record temp_record;
-    bool       hit_anything   = false;
-    auto       closest_so_far = t_max;
+    bool hit_anything   = false;
+    auto closest_so_far = t_max;
 
+    // A miss leaves the record alone, so the closest hit stays in it.
     for(const auto& object : objects) {
-        if(object->hit(r, t_min, closest_so_far, temp_record)) {
+        if(object->hit(r, t_min, closest_so_far, rec)) {
             hit_anything   = true;
-            closest_so_far = temp_record.t;
-            rec            = temp_record;
+            closest_so_far = rec.t;
         }
     }
 
     return hit_anything;
 }
 
+bool hittable_list::bounding_box(aabb& output_box) const
+{
+    if(objects.empty())
+        return false;
+
+    aabb temp_box;
+    output_box = aabb();
+
+    for(const auto& object : objects) {
+        if(!object->bounding_box(temp_box))
+            return false;
+        output_box.expand(temp_box);
+    }
+
+    return true;
+}
+
 #endif // HITTABLE_LIST_H
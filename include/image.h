@@ -1,48 +1,86 @@
 #pragma once
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <format>
 #include <fstream>
 #include <iostream>
 #include "common.h"
 #include "config.h"
 
-inline void write_as_ppm(color* pBuf, Prefs& prefs, const char* path)
+/*
+ * FNV-1a over the raw sample sums. Renders with the same settings hash the
+ * same on any thread count or tile split, so a changed hash means the image
+ * changed, even if only in the last bit.
+ */
+inline uint64_t image_hash(const color* pixels, size_t count)
 {
-    std::ofstream file(path);
-    if (!file.is_open()) {
-        std::cerr << std::format("Error: Couldn't write to '{}'.\n", path);
-        return;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < count; i++) {
+        for (int c = 0; c < 3; c++) {
+            double        value = pixels[i][c];
+            unsigned char bytes[sizeof(double)];
+            std::memcpy(bytes, &value, sizeof(value));
+            for (auto b : bytes) {
+                hash ^= b;
+                hash *= 0x100000001b3ull;
+            }
+        }
     }
+    return hash;
+}
 
-    file << std::format("P3\n{} {}\n255\n", prefs.image_width, prefs.image_height);
-
-    for (int j = prefs.image_height - 1; j >= 0; --j) {
-        for (int i = 0; i < prefs.image_width; ++i) {
-            auto& pixel = pBuf[j * prefs.image_width + i];
-
-            auto r = pixel.x();
-            auto g = pixel.y();
-            auto b = pixel.z();
-
-            /* divide the coler by the number of samples */
-            auto scale = 1.0 / prefs.samples_per_pixel;
-            r = sqrt(scale * r);
-            g = sqrt(scale * g);
-            b = sqrt(scale * b);
+/*
+ * Plain-text PPM of the averaged, gamma corrected samples, top row first.
+ * The header comment records the sample count, which a time-budgeted render
+ * only knows at the end.
+ */
+inline std::string encode_ppm(const color* pBuf, int width, int height, int samples_per_pixel)
+{
+    // "255 255 255\n" is the longest pixel.
+    std::string out = std::format("P3\n# samples per pixel {}\n{} {}\n255\n", samples_per_pixel, width, height);
+    out.reserve(out.size() + static_cast<size_t>(width) * height * 12);
 
-            auto finalCol = color(
-                256 * clamp(r, 0.0, 0.999),
-                256 * clamp(g, 0.0, 0.999),
-                256 * clamp(b, 0.0, 0.999)
-            );
+    auto append = [&](double value, char separator) {
+        int  v = static_cast<int>(256 * clamp(value, 0.0, 0.999));
+        char digits[4];
+        int  n = 0;
+        do {
+            digits[n++] = static_cast<char>('0' + v % 10);
+            v /= 10;
+        } while (v > 0);
+        while (n > 0)
+            out.push_back(digits[--n]);
+        out.push_back(separator);
+    };
 
-            file << static_cast<int>(finalCol.x()) << ' '
-                 << static_cast<int>(finalCol.y()) << ' '
-                 << static_cast<int>(finalCol.z()) << '\n';
+    /* divide the coler by the number of samples */
+    /* spectral estimates can end up slightly outside the RGB gamut, i.e. negative */
+    auto scale = 1.0 / samples_per_pixel;
+    for (int j = height - 1; j >= 0; --j) {
+        for (int i = 0; i < width; ++i) {
+            auto& pixel = pBuf[j * width + i];
+            append(sqrt(fmax(0.0, scale * pixel.x())), ' ');
+            append(sqrt(fmax(0.0, scale * pixel.y())), ' ');
+            append(sqrt(fmax(0.0, scale * pixel.z())), '\n');
         }
     }
 
-    file.close();
+    return out;
+}
 
-    std::cerr << std::format("Info: Saved output to '{}'.\n", path);
+inline bool write_file(const std::string& data, const char* path)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open() || !file.write(data.data(), data.size())) {
+        std::cerr << std::format("Error: Couldn't write to '{}'.\n", path);
+        return false;
+    }
+    return true;
+}
+
+inline void write_as_ppm(const color* pBuf, const Prefs& prefs, const char* path)
+{
+    if (write_file(encode_ppm(pBuf, prefs.image_width, prefs.image_height, prefs.samples_per_pixel), path))
+        std::cerr << std::format("Info: Saved output to '{}'.\n", path);
 }
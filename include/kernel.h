@@ -0,0 +1,294 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include "bvh.h"
+#include "camera.h"
+#include "common.h"
+#include "config.h"
+#include "hittable.h"
+#include "material.h"
+#include "sampler.h"
+#include "spectrum.h"
+
+/*
+ * Render kernels specialized at compile time on the sampler type and on
+ * whether the camera has defocus blur. Inside a kernel the sampler and the
+ * built-in materials are called directly instead of through their vtables,
+ * so the compiler can inline the whole bounce loop. A small table picks the
+ * kernel for the current settings once per call site.
+ *
+ * Kernels render a horizontal span of pixels. When the world is a BVH the
+ * camera rays of neighbouring pixels are traced as packets, and each lane
+ * continues its path on its own after the first hit.
+ *
+ * Spectral kernels carry four wavelengths per path instead of RGB and
+ * resolve them to RGB at the end of each path (see spectrum.h).
+ */
+
+// First-hit surface data of a camera sample, used to guide the denoiser.
+struct aov_sample {
+    color albedo;
+    vec3  normal;
+};
+
+// Sums over all samples of one pixel.
+struct pixel_result {
+    color beauty;
+    color albedo;
+    vec3  normal;
+};
+
+// Rays traced by the calling thread, camera rays and bounces alike.
+inline uint64_t& rays_traced()
+{
+    thread_local uint64_t count = 0;
+    return count;
+}
+
+/* Calls a concrete sampler's functions without going through the vtable. */
+template<typename S>
+struct direct_sampler {
+    S& s;
+
+    void    start_pixel_sample(int x, int y, int i) { s.S::start_pixel_sample(x, y, i); }
+    double  get_1d()                                { return s.S::get_1d(); }
+    sample2 get_2d()                                { return s.S::get_2d(); }
+};
+
+template<typename Sampler>
+inline bool scatter(const material& m, const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered,
+                    direct_sampler<Sampler>& smp)
+{
+    switch (m.kind) {
+        case material_kind::lambertian: return static_cast<const lambertian&>(m).sample(r_in, rec, attenuation, scattered, smp);
+        case material_kind::metal:      return static_cast<const metal&>(m).sample(r_in, rec, attenuation, scattered, smp);
+        case material_kind::dielectric: return static_cast<const dielectric&>(m).sample(r_in, rec, attenuation, scattered, smp);
+        default:                        return m.scatter(r_in, rec, attenuation, scattered, smp.s);
+    }
+}
+
+/*
+ * Path throughput loop; the same as recursing once per bounce. The first
+ * intersection of 'r' has already been found ('hit' and 'h'). The surface
+ * is only evaluated for the closest hit of each bounce.
+ */
+template<typename Sampler>
+inline color shade(ray r, bool hit, ray_hit h, const hittable& world, int depth, direct_sampler<Sampler>& smp,
+                   aov_sample& aov)
+{
+    color      throughput(1.0, 1.0, 1.0);
+    hit_record rec;
+
+    for (int bounce = 0; bounce < depth; bounce++) {
+        rays_traced()++;
+        if (bounce > 0)
+            hit = world.hit(r, 0.001, infinity, h);
+
+        if (!hit) {
+            vec3  unit_direction = r.direction();
+            auto  t              = 0.5*(unit_direction.y() + 1.0);
+            color sky            = (1.0-t)*color(1.0, 1.0, 1.0) + t*color(0.5, 0.7, 1.0);
+
+            if (bounce == 0) {
+                aov.albedo = sky;
+                aov.normal = vec3(0, 0, 0);
+            }
+            return throughput * sky;
+        }
+
+        h.object->surface(r, h, rec);
+        if (bounce == 0) {
+            aov.albedo = rec.mat_ptr->aov_albedo();
+            aov.normal = rec.normal;
+        }
+
+        color attenuation;
+        ray   scattered;
+        if (!scatter(*rec.mat_ptr, r, rec, attenuation, scattered, smp))
+            return color(0,0,0);
+
+        throughput = throughput * attenuation;
+        r          = scattered;
+    }
+
+    // If we've exceeded the ray bounce limit, no more light is gathered.
+    return color(0,0,0);
+}
+
+/*
+ * shade() with one throughput value per wavelength. The wavelengths are the
+ * next sampler dimension after the camera ray. Colors of materials and the
+ * sky are evaluated at those wavelengths; glass refracts the hero wavelength
+ * with its own index.
+ */
+template<typename Sampler>
+inline color shade_spectral(ray r, bool hit, ray_hit h, const hittable& world, int depth,
+                            direct_sampler<Sampler>& smp, aov_sample& aov)
+{
+    auto               wl = spectral::wavelengths::sample(smp.get_1d());
+    spectral::spectrum throughput(1.0);
+    hit_record         rec;
+
+    for (int bounce = 0; bounce < depth; bounce++) {
+        rays_traced()++;
+        if (bounce > 0)
+            hit = world.hit(r, 0.001, infinity, h);
+
+        if (!hit) {
+            vec3  unit_direction = r.direction();
+            auto  t              = 0.5*(unit_direction.y() + 1.0);
+            color sky            = (1.0-t)*color(1.0, 1.0, 1.0) + t*color(0.5, 0.7, 1.0);
+
+            if (bounce == 0) {
+                aov.albedo = sky;
+                aov.normal = vec3(0, 0, 0);
+            }
+            return wl.to_rgb(throughput * wl.from_rgb(sky));
+        }
+
+        h.object->surface(r, h, rec);
+        if (bounce == 0) {
+            aov.albedo = rec.mat_ptr->aov_albedo();
+            aov.normal = rec.normal;
+        }
+
+        const material& m = *rec.mat_ptr;
+        ray             scattered;
+
+        if (m.kind == material_kind::dielectric) {
+            // Clear glass attenuates nothing; only the direction depends on the wavelength.
+            auto& glass = static_cast<const dielectric&>(m);
+            if (glass.dispersive())
+                wl.terminate_secondary();
+            glass.sample_at(wl.hero(), r, rec, scattered, smp);
+        } else {
+            color attenuation;
+            if (!scatter(m, r, rec, attenuation, scattered, smp))
+                return color(0,0,0);
+            throughput *= wl.from_rgb(attenuation);
+        }
+
+        r = scattered;
+    }
+
+    return color(0,0,0);
+}
+
+template<typename Sampler, bool Spectral = false>
+inline color shade_as(const ray& r, bool hit, const ray_hit& h, const hittable& world, int depth,
+                      direct_sampler<Sampler>& smp, aov_sample& aov)
+{
+    if constexpr (Spectral)
+        return shade_spectral(r, hit, h, world, depth, smp, aov);
+    else
+        return shade(r, hit, h, world, depth, smp, aov);
+}
+
+template<typename Sampler, bool Spectral = false>
+inline color ray_color(const ray& r, const hittable& world, int depth, direct_sampler<Sampler>& smp, aov_sample& aov)
+{
+    if (depth <= 0)
+        return color(0,0,0);
+
+    ray_hit h;
+    bool    hit = world.hit(r, 0.001, infinity, h);
+    return shade_as<Sampler, Spectral>(r, hit, h, world, depth, smp, aov);
+}
+
+inline void accumulate(pixel_result& result, const color& beauty, const aov_sample& aov)
+{
+    result.beauty += beauty;
+    result.albedo += aov.albedo;
+    result.normal += aov.normal;
+}
+
+/* Camera ray for sample 's' of pixel (i, j); starts the sampler on that sample. */
+template<typename Sampler, bool Defocus>
+inline ray camera_ray(const Prefs& prefs, const camera& cam, int i, int j, int s, direct_sampler<Sampler>& smp)
+{
+    smp.start_pixel_sample(i, j, s);
+    auto jitter = smp.get_2d();
+    auto u      = (i + jitter.u) / (prefs.image_width  - 1);
+    auto v      = (j + jitter.v) / (prefs.image_height - 1);
+    return cam.sample_ray<Defocus>(u, v, smp);
+}
+
+/*
+ * Samples [first, first + count) of the pixels x0 .. x0 + width - 1 of row
+ * j, summed into 'out'.
+ */
+template<typename Sampler, bool Defocus, bool Spectral>
+inline void render_span_as(const Prefs& prefs, const camera& cam, const hittable& world, int x0, int j, int width,
+                           int first, int count, pixel_result* out, sampler& generic)
+{
+    assert(dynamic_cast<Sampler*>(&generic));
+    auto& base  = static_cast<Sampler&>(generic);
+    auto* accel = dynamic_cast<const bvh*>(&world);
+
+    constexpr int lanes = ray_packet::width;
+
+    std::fill(out, out + width, pixel_result{});
+
+    for (int s = first; s < first + count; ++s) {
+        int x = 0;
+
+        // Each lane keeps its own copy of the sampler, so its path can
+        // continue with the dimensions that follow its camera sample.
+        if (accel && prefs.max_depth > 0) {
+            ray_packet             packet;
+            ray_hit                recs[lanes];
+            std::optional<Sampler> lane_samplers[lanes];
+
+            for (; x + lanes <= width; x += lanes) {
+                for (int k = 0; k < lanes; k++) {
+                    direct_sampler<Sampler> smp{ lane_samplers[k].emplace(base) };
+                    packet.set(k, camera_ray<Sampler, Defocus>(prefs, cam, x0 + x + k, j, s, smp));
+                }
+
+                // Incoherent lanes are traced on their own instead.
+                auto coherent = packet.coherent_lanes();
+                auto hits     = accel->hit_packet(packet, 0.001, coherent, recs);
+
+                for (int k = 0; k < lanes; k++) {
+                    direct_sampler<Sampler> smp{ *lane_samplers[k] };
+                    aov_sample              aov;
+                    color                   beauty = (coherent >> k & 1)
+                        ? shade_as<Sampler, Spectral>(packet.rays[k], (hits >> k & 1) != 0, recs[k], world, prefs.max_depth, smp, aov)
+                        : ray_color<Sampler, Spectral>(packet.rays[k], world, prefs.max_depth, smp, aov);
+                    accumulate(out[x + k], beauty, aov);
+                }
+            }
+        }
+
+        for (; x < width; x++) {
+            direct_sampler<Sampler> smp{ base };
+            ray        r = camera_ray<Sampler, Defocus>(prefs, cam, x0 + x, j, s, smp);
+            aov_sample aov;
+            accumulate(out[x], ray_color<Sampler, Spectral>(r, world, prefs.max_depth, smp, aov), aov);
+        }
+    }
+}
+
+using span_kernel = void (*)(const Prefs&, const camera&, const hittable&, int, int, int, int, int, pixel_result*, sampler&);
+
+/*
+ * The kernel for the render settings and camera. The sampler passed to it
+ * must come from make_sampler() with the same type.
+ */
+inline span_kernel select_kernel(const Prefs& prefs, const camera& cam)
+{
+    static constexpr span_kernel kernels[4][2][2] = {
+        { { render_span_as<independent_sampler, false, false>, render_span_as<independent_sampler, false, true> },
+          { render_span_as<independent_sampler, true, false>,  render_span_as<independent_sampler, true, true> } },
+        { { render_span_as<stratified_sampler, false, false>,  render_span_as<stratified_sampler, false, true> },
+          { render_span_as<stratified_sampler, true, false>,   render_span_as<stratified_sampler, true, true> } },
+        { { render_span_as<sobol_sampler, false, false>,       render_span_as<sobol_sampler, false, true> },
+          { render_span_as<sobol_sampler, true, false>,        render_span_as<sobol_sampler, true, true> } },
+        { { render_span_as<blue_noise_sampler, false, false>,  render_span_as<blue_noise_sampler, false, true> },
+          { render_span_as<blue_noise_sampler, true, false>,   render_span_as<blue_noise_sampler, true, true> } },
+    };
+
+    return kernels[static_cast<int>(prefs.sampler)][cam.has_defocus()][prefs.spectral];
+}
@@ -0,0 +1,167 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#   define NOMINMAX
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+/*
+ * File mapped into memory. Other processes mapping the same file see
+ * writes without any copies, which makes it usable as shared memory
+ * (e.g. a file in /dev/shm).
+ */
+class mapped_file {
+    public:
+        mapped_file() = default;
+        ~mapped_file() { close(); }
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+        mapped_file(mapped_file&& other) noexcept { *this = std::move(other); }
+        mapped_file& operator=(mapped_file&& other) noexcept
+        {
+            if (this != &other) {
+                close();
+                bytes = std::exchange(other.bytes, nullptr);
+                length = std::exchange(other.length, 0);
+#ifdef _WIN32
+                file = std::exchange(other.file, INVALID_HANDLE_VALUE);
+                mapping = std::exchange(other.mapping, nullptr);
+#endif
+            }
+            return *this;
+        }
+
+        // Creates (or truncates) the file with the given size and maps it read-write.
+        static mapped_file create(const std::string& path, size_t size)
+        {
+            mapped_file m;
+#ifdef _WIN32
+            m.file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                 nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (m.file == INVALID_HANDLE_VALUE)
+                return m;
+            m.mapping = CreateFileMappingA(m.file, nullptr, PAGE_READWRITE,
+                                           static_cast<DWORD>(static_cast<unsigned long long>(size) >> 32),
+                                           static_cast<DWORD>(size), nullptr);
+            if (m.mapping)
+                m.bytes = static_cast<std::byte*>(MapViewOfFile(m.mapping, FILE_MAP_ALL_ACCESS, 0, 0, size));
+#else
+            int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0)
+                return m;
+            if (::ftruncate(fd, static_cast<off_t>(size)) == 0) {
+                void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (p != MAP_FAILED)
+                    m.bytes = static_cast<std::byte*>(p);
+            }
+            ::close(fd);
+#endif
+            if (m.bytes)
+                m.length = size;
+            return m;
+        }
+
+        // Maps an existing file read-only.
+        static mapped_file open(const std::string& path)
+        {
+            mapped_file m;
+#ifdef _WIN32
+            m.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                 nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            LARGE_INTEGER size;
+            if (m.file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m.file, &size) || size.QuadPart == 0)
+                return m;
+            m.mapping = CreateFileMappingA(m.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (m.mapping)
+                m.bytes = static_cast<std::byte*>(MapViewOfFile(m.mapping, FILE_MAP_READ, 0, 0, 0));
+            if (m.bytes)
+                m.length = static_cast<size_t>(size.QuadPart);
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return m;
+            struct stat info;
+            if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+                void* p = ::mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+                if (p != MAP_FAILED) {
+                    m.bytes  = static_cast<std::byte*>(p);
+                    m.length = static_cast<size_t>(info.st_size);
+                }
+            }
+            ::close(fd);
+#endif
+            return m;
+        }
+
+        /*
+         * Maps 'size' bytes starting at 'offset' of an existing file read-only.
+         * The offset has to be a multiple of the allocation granularity
+         * (64 KiB covers every platform we build on).
+         */
+        static mapped_file open(const std::string& path, size_t offset, size_t size)
+        {
+            mapped_file m;
+#ifdef _WIN32
+            m.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                 nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (m.file == INVALID_HANDLE_VALUE)
+                return m;
+            m.mapping = CreateFileMappingA(m.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (m.mapping)
+                m.bytes = static_cast<std::byte*>(MapViewOfFile(
+                    m.mapping, FILE_MAP_READ,
+                    static_cast<DWORD>(static_cast<unsigned long long>(offset) >> 32), static_cast<DWORD>(offset), size));
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return m;
+            void* p = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(offset));
+            if (p != MAP_FAILED)
+                m.bytes = static_cast<std::byte*>(p);
+            ::close(fd);
+#endif
+            if (m.bytes)
+                m.length = size;
+            return m;
+        }
+
+        void close()
+        {
+#ifdef _WIN32
+            if (bytes)
+                UnmapViewOfFile(bytes);
+            if (mapping)
+                CloseHandle(std::exchange(mapping, nullptr));
+            if (file != INVALID_HANDLE_VALUE)
+                CloseHandle(std::exchange(file, INVALID_HANDLE_VALUE));
+#else
+            if (bytes)
+                ::munmap(bytes, length);
+#endif
+            bytes  = nullptr;
+            length = 0;
+        }
+
+        bool valid() const { return bytes != nullptr; }
+
+        std::byte*       data()       { return bytes; }
+        const std::byte* data() const { return bytes; }
+        size_t           size() const { return length; }
+
+    private:
+        std::byte* bytes  = nullptr;
+        size_t     length = 0;
+#ifdef _WIN32
+        HANDLE file    = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#endif
+};
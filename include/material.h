@@ -3,96 +3,193 @@
 
 #include "common.h"
 #include "hittable.h"
+#include "sampler.h"
+
+// Lets the templated render kernels call the built-in materials without a virtual call.
+enum class material_kind {
+    lambertian,
+    metal,
+    dielectric,
+    other,
+};
 
 class material {
     public:
+        material(material_kind kind = material_kind::other) : kind(kind) {}
         virtual ~material() = default;
 
         virtual bool scatter(
             const ray& r_in,
             const hit_record& rec,
             color& attenuation,
-            ray& scattered
+            ray& scattered,
+            sampler& smp
         ) const = 0;
+
+        // Reflectance written to the albedo AOV that guides the denoiser.
+        virtual color aov_albedo() const { return color(1.0, 1.0, 1.0); }
+
+    public:
+        const material_kind kind;
 };
 
-class lambertian : public material {
+class lambertian final : public material {
     public:
-        lambertian(const color& a) : albedo(a) {}
+        lambertian(const color& a) : material(material_kind::lambertian), albedo(a) {}
 
         virtual bool scatter(
             const ray& r_in,
             const hit_record& rec,
             color& attenuation,
-            ray& scattered
+            ray& scattered,
+            sampler& smp
         ) const override
         {
-            auto scatter_dir = rec.normal + random_unit_vector();
+            return sample(r_in, rec, attenuation, scattered, smp);
+        }
+
+        // Same as scatter(), with the sampler type known at compile time.
+        template<typename Sampler>
+        bool sample(
+            const ray& r_in,
+            const hit_record& rec,
+            color& attenuation,
+            ray& scattered,
+            Sampler& smp
+        ) const
+        {
+            auto u           = smp.get_2d();
+            auto scatter_dir = rec.normal + sample_unit_vector(u.u, u.v);
             if(scatter_dir.near_zero())
                 scatter_dir = rec.normal;
 
-            scattered        = ray(rec.point, scatter_dir);
+            scattered        = ray(rec.point, scatter_dir, r_in.time());
             attenuation      = albedo;
             return true;
         }
+
+        virtual color aov_albedo() const override { return albedo; }
+
     public:
         color albedo;
 };
 
-class metal : public material {
+class metal final : public material {
     public:
-        metal(const color& a, double f) : albedo(a), fuzz(f < 1 ? f : 1) {}
+        metal(const color& a, double f) : material(material_kind::metal), albedo(a), fuzz(f < 1 ? f : 1) {}
 
         virtual bool scatter(
             const ray& r_in,
             const hit_record& rec,
             color& attenuation,
-            ray& scattered
+            ray& scattered,
+            sampler& smp
         ) const override
         {
-            vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
-            scattered      = ray(rec.point, reflected + fuzz * random_in_unit_sphere());
+            return sample(r_in, rec, attenuation, scattered, smp);
+        }
+
+        // Same as scatter(), with the sampler type known at compile time.
+        template<typename Sampler>
+        bool sample(
+            const ray& r_in,
+            const hit_record& rec,
+            color& attenuation,
+            ray& scattered,
+            Sampler& smp
+        ) const
+        {
+            auto u         = smp.get_2d();
+            vec3 reflected = reflect(r_in.direction(), rec.normal);
+            scattered      = ray(rec.point, reflected + fuzz * sample_unit_sphere(u.u, u.v, smp.get_1d()), r_in.time());
             attenuation    = albedo;
             return (dot(scattered.direction(), rec.normal) > 0);
         }
 
+        virtual color aov_albedo() const override { return albedo; }
+
     public:
         color albedo;
         double fuzz;
 };
 
-class dielectric : public material {
+class dielectric final : public material {
     public:
-        dielectric(double index_of_refraction) : ir(index_of_refraction) {}
+        /*
+         * 'index_of_refraction' is the index at 587.6 nm, the one used when
+         * rendering in RGB. A nonzero 'cauchy_b' (in square micrometres, about
+         * 0.0042 for crown glass) adds dispersion for spectral rendering.
+         */
+        dielectric(double index_of_refraction, double cauchy_b = 0)
+            : material(material_kind::dielectric), ir(index_of_refraction), cauchy_b(cauchy_b) {}
 
         virtual bool scatter(
             const ray& r_in,
             const hit_record& rec,
             color& attenuation,
-            ray& scattered
+            ray& scattered,
+            sampler& smp
         ) const override
+        {
+            return sample(r_in, rec, attenuation, scattered, smp);
+        }
+
+        // Same as scatter(), with the sampler type known at compile time.
+        template<typename Sampler>
+        bool sample(
+            const ray& r_in,
+            const hit_record& rec,
+            color& attenuation,
+            ray& scattered,
+            Sampler& smp
+        ) const
         {
             attenuation = color(1.0, 1.0, 1.0);
-            double refraction_ratio = rec.front_face ? (1.0 / ir) : ir;
-            vec3   unit_direction   = unit_vector(r_in.direction());
-            double cos_theta        = fmin(dot(-unit_direction, rec.normal), 1.0);
-            double sin_theta        = sqrt(1.0 - cos_theta * cos_theta);
-            bool   cannot_refract   = refraction_ratio * sin_theta > 1.0;
-            vec3   direction;
-
-            if(cannot_refract || reflectance(cos_theta, refraction_ratio) > random_double()) 
-                direction = reflect(unit_direction, rec.normal);
-            else
-                direction = refract(unit_direction, rec.normal, refraction_ratio);
-            
-            scattered = ray(rec.point, direction);
+            scattered   = ray(rec.point, direction_for(ir, r_in, rec, smp.get_1d()), r_in.time());
+            return true;
+        }
+
+        // Scatters for light of wavelength 'lambda' (in nm), which matters if the glass is dispersive.
+        template<typename Sampler>
+        bool sample_at(
+            double lambda,
+            const ray& r_in,
+            const hit_record& rec,
+            ray& scattered,
+            Sampler& smp
+        ) const
+        {
+            scattered = ray(rec.point, direction_for(index_at(lambda), r_in, rec, smp.get_1d()), r_in.time());
             return true;
         }
 
+        bool dispersive() const { return cauchy_b != 0; }
+
+        // Cauchy's equation, anchored so that the index at 587.6 nm is 'ir'.
+        double index_at(double lambda) const
+        {
+            double um = lambda * 1e-3;
+            return ir + cauchy_b * (1 / (um * um) - 1 / (0.5876 * 0.5876));
+        }
+
     public:
         double ir; /* index of refraction */
+        double cauchy_b;
 
     private:
+        static vec3 direction_for(double index, const ray& r_in, const hit_record& rec, double u)
+        {
+            double refraction_ratio = rec.front_face ? (1.0 / index) : index;
+            vec3   unit_direction   = r_in.direction();
+            double cos_theta        = fmin(dot(-unit_direction, rec.normal), 1.0);
+            double sin_theta        = sqrt(1.0 - cos_theta * cos_theta);
+            bool   cannot_refract   = refraction_ratio * sin_theta > 1.0;
+
+            if(cannot_refract || reflectance(cos_theta, refraction_ratio) > u)
+                return reflect(unit_direction, rec.normal);
+            return refract(unit_direction, rec.normal, refraction_ratio);
+        }
+
         static double reflectance(double cosine, double ref_idx)
         {
             auto r0 = (1 - ref_idx) / (1 + ref_idx);
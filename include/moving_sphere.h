@@ -0,0 +1,88 @@
+#ifndef MOVING_SPHERE_H
+#define MOVING_SPHERE_H
+
+#include "common.h"
+#include "hittable.h"
+
+/* Sphere moving linearly from center0 at time0 to center1 at time1. */
+class moving_sphere : public hittable {
+    public:
+        moving_sphere() {}
+        moving_sphere(
+            point3 cen0, point3 cen1, double _time0, double _time1, double r, shared_ptr<material> m)
+            : center0(cen0), center1(cen1), time0(_time0), time1(_time1), radius(r), radius2(r * r), inv_radius(1 / r),
+              mat_ptr(m) {};
+
+        virtual bool hit(
+            const ray& r,
+            double t_min,
+            double t_max,
+            ray_hit& rec
+        ) const override;
+
+        virtual void surface(const ray& r, const ray_hit& h, hit_record& rec) const override;
+
+        // Bounds the whole motion, so the BVH stays valid for any ray time.
+        virtual bool bounding_box(aabb& output_box) const override;
+
+        point3 center(double time) const
+        {
+            return center0 + ((time - time0) / (time1 - time0)) * (center1 - center0);
+        }
+
+    public:
+        point3 center0, center1;
+        double time0, time1;
+        double radius;
+        double radius2;
+        double inv_radius;
+        shared_ptr<material> mat_ptr;
+};
+
+bool moving_sphere::hit(const ray& r, double t_min, double t_max, ray_hit& rec) const
+{
+    point3 cen    = center(r.time());
+    vec3   oc     = r.origin() - cen;
+    auto   half_b = dot(oc, r.direction());
+    auto   c      = oc.length_squared() - radius2;
+
+    auto discriminant = (half_b * half_b) - c;
+    if(discriminant < 0) 
+        return false;
+
+    auto sqrtd = sqrt(discriminant);
+
+    auto root = -half_b - sqrtd;
+    if(root < t_min || t_max < root) {
+        root = -half_b + sqrtd;
+        if(root < t_min || t_max < root)
+            return false;
+    }
+
+    rec.t      = root;
+    rec.object = this;
+    return true; 
+}
+
+void moving_sphere::surface(const ray& r, const ray_hit& h, hit_record& rec) const
+{
+    point3 cen = center(r.time());
+    rec.t       = h.t;
+    rec.point   = r.at(rec.t);
+    rec.mat_ptr = mat_ptr.get();
+
+    vec3 outward_normal = (rec.point - cen) * inv_radius;
+    rec.set_face_normal(r, outward_normal);
+}
+
+bool moving_sphere::bounding_box(aabb& output_box) const
+{
+    auto extent = vec3(radius, radius, radius);
+    output_box  = surrounding_box(
+        aabb(center0 - extent, center0 + extent),
+        aabb(center1 - extent, center1 + extent)
+    );
+    return true;
+}
+
+#endif // MOVING_SPHERE_H
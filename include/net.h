@@ -0,0 +1,291 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#   include <winsock2.h>
+#   include <ws2tcpip.h>
+#   pragma comment(lib, "ws2_32.lib")
+#else
+#   include <arpa/inet.h>
+#   include <netdb.h>
+#   include <netinet/in.h>
+#   include <netinet/tcp.h>
+#   include <sys/socket.h>
+#   include <sys/time.h>
+#   include <unistd.h>
+#endif
+
+/*
+ * Minimal blocking TCP sockets plus a byte buffer for length-prefixed
+ * messages. Both ends are expected to run the same build on the same
+ * architecture, so values are sent in native byte order.
+ */
+namespace net {
+
+#ifdef _WIN32
+using native_handle = SOCKET;
+constexpr native_handle invalid_handle = INVALID_SOCKET;
+
+inline void startup()
+{
+    static bool started = [] {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    (void)started;
+}
+
+inline void close_handle(native_handle h) { closesocket(h); }
+#else
+using native_handle = int;
+constexpr native_handle invalid_handle = -1;
+
+inline void startup() {}
+inline void close_handle(native_handle h) { ::close(h); }
+#endif
+
+class socket {
+    public:
+        socket() = default;
+        explicit socket(native_handle h) : handle(h) {}
+        ~socket() { close(); }
+
+        socket(const socket&) = delete;
+        socket& operator=(const socket&) = delete;
+        socket(socket&& other) noexcept : handle(std::exchange(other.handle, invalid_handle)) {}
+        socket& operator=(socket&& other) noexcept
+        {
+            if (this != &other) {
+                close();
+                handle = std::exchange(other.handle, invalid_handle);
+            }
+            return *this;
+        }
+
+        bool valid() const { return handle != invalid_handle; }
+
+        void close()
+        {
+            if (valid())
+                close_handle(std::exchange(handle, invalid_handle));
+        }
+
+        // Wakes up a thread blocked on this socket, e.g. from another thread.
+        void shutdown()
+        {
+            if (valid()) {
+#ifdef _WIN32
+                ::shutdown(handle, SD_BOTH);
+#else
+                ::shutdown(handle, SHUT_RDWR);
+#endif
+            }
+        }
+
+        // A receive that takes longer than this fails; 0 waits forever.
+        void set_timeout(int milliseconds)
+        {
+#ifdef _WIN32
+            DWORD value = milliseconds;
+            setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&value), sizeof(value));
+#else
+            timeval value = { milliseconds / 1000, (milliseconds % 1000) * 1000 };
+            setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, &value, sizeof(value));
+#endif
+        }
+
+        bool send_all(const void* data, size_t size)
+        {
+            auto* bytes = static_cast<const char*>(data);
+            while (size > 0) {
+#ifdef _WIN32
+                int sent = ::send(handle, bytes, static_cast<int>(size), 0);
+#else
+                auto sent = ::send(handle, bytes, size, MSG_NOSIGNAL);
+#endif
+                if (sent <= 0)
+                    return false;
+                bytes += sent;
+                size  -= sent;
+            }
+            return true;
+        }
+
+        bool recv_all(void* data, size_t size)
+        {
+            auto* bytes = static_cast<char*>(data);
+            while (size > 0) {
+#ifdef _WIN32
+                int received = ::recv(handle, bytes, static_cast<int>(size), 0);
+#else
+                auto received = ::recv(handle, bytes, size, 0);
+#endif
+                if (received <= 0)
+                    return false;
+                bytes += received;
+                size  -= received;
+            }
+            return true;
+        }
+
+        // Messages are a 64-bit length followed by the payload.
+        bool send_message(const std::vector<char>& payload)
+        {
+            uint64_t size = payload.size();
+            return send_all(&size, sizeof(size)) && send_all(payload.data(), payload.size());
+        }
+
+        bool recv_message(std::vector<char>& payload, uint64_t max_size = 1ull << 32)
+        {
+            uint64_t size;
+            if (!recv_all(&size, sizeof(size)) || size > max_size)
+                return false;
+            payload.resize(size);
+            return recv_all(payload.data(), size);
+        }
+
+        native_handle native() const { return handle; }
+
+    private:
+        native_handle handle = invalid_handle;
+};
+
+inline socket listen(int port, const char* address = "0.0.0.0")
+{
+    startup();
+
+    socket s(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    if (!s.valid())
+        return s;
+
+    int yes = 1;
+    setsockopt(s.native(), SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&yes), sizeof(yes));
+
+    sockaddr_in addr = {};
+    addr.sin_family  = AF_INET;
+    addr.sin_port    = htons(static_cast<uint16_t>(port));
+    inet_pton(AF_INET, address, &addr.sin_addr);
+
+    if (::bind(s.native(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(s.native(), 64) != 0)
+        return socket();
+
+    return s;
+}
+
+inline socket accept(socket& listener)
+{
+    socket s(::accept(listener.native(), nullptr, nullptr));
+    if (s.valid()) {
+        int yes = 1;
+        setsockopt(s.native(), IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&yes), sizeof(yes));
+    }
+    return s;
+}
+
+inline socket connect(const std::string& host, int port)
+{
+    startup();
+
+    addrinfo hints = {};
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0)
+        return socket();
+
+    socket s;
+    for (auto* info = result; info; info = info->ai_next) {
+        s = socket(::socket(info->ai_family, info->ai_socktype, info->ai_protocol));
+        if (s.valid() && ::connect(s.native(), info->ai_addr, static_cast<int>(info->ai_addrlen)) == 0)
+            break;
+        s.close();
+    }
+    freeaddrinfo(result);
+
+    if (s.valid()) {
+        int yes = 1;
+        setsockopt(s.native(), IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&yes), sizeof(yes));
+    }
+    return s;
+}
+
+/* Appends trivially copyable values to a message payload. */
+class writer {
+    public:
+        template<typename T>
+        writer& operator<<(const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            auto* bytes = reinterpret_cast<const char*>(&value);
+            data.insert(data.end(), bytes, bytes + sizeof(T));
+            return *this;
+        }
+
+        writer& operator<<(const std::string& value)
+        {
+            *this << static_cast<uint64_t>(value.size());
+            data.insert(data.end(), value.begin(), value.end());
+            return *this;
+        }
+
+        void write(const void* src, size_t size)
+        {
+            auto* bytes = static_cast<const char*>(src);
+            data.insert(data.end(), bytes, bytes + size);
+        }
+
+        std::vector<char> data;
+};
+
+/* Reads values back in the order they were written; ok() turns false on underflow. */
+class reader {
+    public:
+        explicit reader(const std::vector<char>& data) : data(data) {}
+
+        template<typename T>
+        reader& operator>>(T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            read(&value, sizeof(T));
+            return *this;
+        }
+
+        reader& operator>>(std::string& value)
+        {
+            uint64_t size = 0;
+            *this >> size;
+            if (!good || data.size() - offset < size) {
+                good = false;
+                return *this;
+            }
+            value.assign(data.data() + offset, size);
+            offset += size;
+            return *this;
+        }
+
+        void read(void* dst, size_t size)
+        {
+            if (!good || data.size() - offset < size) {
+                good = false;
+                return;
+            }
+            std::memcpy(dst, data.data() + offset, size);
+            offset += size;
+        }
+
+        bool ok() const { return good; }
+
+    private:
+        const std::vector<char>& data;
+        size_t                   offset = 0;
+        bool                     good   = true;
+};
+
+} // namespace net
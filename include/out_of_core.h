@@ -0,0 +1,688 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "aabb.h"
+#include "arena.h"
+#include "common.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "mapped_file.h"
+#include "material.h"
+#include "sphere.h"
+
+/*
+ * Binary scene format for worlds that don't fit in memory. Spheres are
+ * grouped into spatially coherent chunks; every chunk carries its own flat
+ * BVH and starts on a 64 KiB boundary, so it can be memory mapped and
+ * traversed in place. Only the chunk table and a small hierarchy over the
+ * chunk bounds are loaded up front.
+ *
+ *   scene_file::header
+ *   scene_file::chunk_entry[chunk_count]
+ *   per chunk: scene_file::node[node_count], scene_file::sphere_record[sphere_count]
+ *
+ * Values are stored in native byte order.
+ */
+namespace scene_file {
+
+constexpr uint32_t magic           = 0x53545253; // "SRTS"
+constexpr uint32_t version         = 1;
+constexpr size_t   chunk_alignment = 64 * 1024;
+constexpr uint32_t max_depth       = 48; // of any hierarchy; traversal stacks hold 64 entries
+
+struct box {
+    double min[3];
+    double max[3];
+};
+
+struct header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t chunk_count;
+    uint32_t reserved;
+    uint64_t sphere_count;
+};
+
+struct chunk_entry {
+    box      bounds;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t node_count;
+    uint32_t sphere_count;
+};
+
+// Children of an interior node are adjacent; leaves have count > 0.
+struct node {
+    box      bounds;
+    uint32_t offset;
+    uint32_t count;
+};
+
+struct sphere_record {
+    double   center[3];
+    double   radius;
+    double   albedo[3]; // albedo[0] is the dispersion (Cauchy B) of dielectrics
+    double   param;     // fuzz for metal, index of refraction for dielectrics
+    uint32_t kind;  // material_kind
+    uint32_t reserved;
+};
+
+inline box to_box(const aabb& b)
+{
+    return { { b.minimum.x(), b.minimum.y(), b.minimum.z() }, { b.maximum.x(), b.maximum.y(), b.maximum.z() } };
+}
+
+inline aabb to_aabb(const box& b)
+{
+    return aabb(point3(b.min[0], b.min[1], b.min[2]), point3(b.max[0], b.max[1], b.max[2]));
+}
+
+/*
+ * Median-split hierarchy over 'boxes'. 'order' receives the primitive order
+ * the leaves refer to.
+ */
+inline std::vector<node> build_hierarchy(const std::vector<aabb>& boxes, std::vector<uint32_t>& order, uint32_t leaf_size)
+{
+    std::vector<node> nodes;
+    order.resize(boxes.size());
+    std::iota(order.begin(), order.end(), 0u);
+    if (boxes.empty())
+        return nodes;
+
+    auto build = [&](auto& self, uint32_t index, uint32_t begin, uint32_t end) -> void {
+        aabb bounds, centroids;
+        for (uint32_t i = begin; i < end; i++) {
+            bounds.expand(boxes[order[i]]);
+            centroids.expand(boxes[order[i]].centroid());
+        }
+        nodes[index].bounds = to_box(bounds);
+
+        if (end - begin <= leaf_size) {
+            nodes[index].offset = begin;
+            nodes[index].count  = end - begin;
+            return;
+        }
+
+        int      axis = centroids.longest_axis();
+        uint32_t mid  = begin + (end - begin) / 2;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](uint32_t a, uint32_t b) {
+            return boxes[a].centroid()[axis] < boxes[b].centroid()[axis];
+        });
+
+        auto left = static_cast<uint32_t>(nodes.size());
+        nodes.resize(nodes.size() + 2);
+        nodes[index].offset = left;
+        nodes[index].count  = 0;
+
+        self(self, left, begin, mid);
+        self(self, left + 1, mid, end);
+    };
+
+    nodes.reserve(2 * (boxes.size() / leaf_size + 1));
+    nodes.resize(1);
+    build(build, 0, 0, static_cast<uint32_t>(boxes.size()));
+    return nodes;
+}
+
+/*
+ * Whether 'nodes' form a hierarchy the traversal can walk: children inside
+ * the array, leaves inside the chunk's spheres and no deeper than max_depth.
+ * The writer splits at the median, so only damaged files fail this.
+ */
+inline bool valid_hierarchy(const node* nodes, uint32_t node_count, uint32_t sphere_count)
+{
+    if (node_count == 0)
+        return false;
+
+    struct pending {
+        uint32_t index;
+        uint32_t depth;
+    };
+    std::vector<pending> stack = { { 0, 0 } };
+    uint32_t             seen  = 0;
+
+    while (!stack.empty()) {
+        auto [index, depth] = stack.back();
+        stack.pop_back();
+        if (depth > max_depth || ++seen > node_count)
+            return false;
+
+        const auto& n = nodes[index];
+        if (n.count == 0) {
+            if (n.offset == 0 || n.offset + 1 >= node_count)
+                return false;
+            stack.push_back({ n.offset, depth + 1 });
+            stack.push_back({ n.offset + 1, depth + 1 });
+        } else if (n.offset > sphere_count || n.count > sphere_count - n.offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool hit_box(const box& b, const point3& origin, const vec3& inv_dir, double t_min, double t_max, double& t_near)
+{
+    for (int a = 0; a < 3; a++) {
+        auto t0 = (b.min[a] - origin[a]) * inv_dir[a];
+        auto t1 = (b.max[a] - origin[a]) * inv_dir[a];
+        if (inv_dir[a] < 0.0)
+            std::swap(t0, t1);
+
+        t_min = t0 > t_min ? t0 : t_min;
+        t_max = t1 < t_max ? t1 : t_max;
+        if (t_max < t_min)
+            return false;
+    }
+
+    t_near = t_min;
+    return true;
+}
+
+/*
+ * Writes the spheres of 'world' with built-in materials. Other objects
+ * (moving spheres, custom materials) can't be stored and are skipped.
+ */
+inline bool write(const std::string& path, const hittable_list& world, uint32_t spheres_per_chunk = 4096)
+{
+    std::vector<sphere_record> records;
+    std::vector<aabb>          boxes;
+    size_t                     skipped = 0;
+
+    for (const auto& object : world.objects) {
+        auto* s = dynamic_cast<const sphere*>(object.get());
+        if (!s || !s->mat_ptr) {
+            skipped++;
+            continue;
+        }
+
+        sphere_record record = {};
+        record.center[0] = s->center.x();
+        record.center[1] = s->center.y();
+        record.center[2] = s->center.z();
+        record.radius    = s->radius;
+        record.kind      = static_cast<uint32_t>(s->mat_ptr->kind);
+
+        color albedo;
+        switch (s->mat_ptr->kind) {
+            case material_kind::lambertian:
+                albedo = static_cast<const lambertian&>(*s->mat_ptr).albedo;
+                break;
+            case material_kind::metal:
+                albedo       = static_cast<const metal&>(*s->mat_ptr).albedo;
+                record.param = static_cast<const metal&>(*s->mat_ptr).fuzz;
+                break;
+            case material_kind::dielectric:
+                record.param = static_cast<const dielectric&>(*s->mat_ptr).ir;
+                albedo       = color(static_cast<const dielectric&>(*s->mat_ptr).cauchy_b, 0, 0);
+                break;
+            default:
+                skipped++;
+                continue;
+        }
+        for (int c = 0; c < 3; c++)
+            record.albedo[c] = albedo[c];
+
+        aabb bounds;
+        s->bounding_box(bounds);
+        records.push_back(record);
+        boxes.push_back(bounds);
+    }
+
+    if (skipped > 0)
+        std::cerr << std::format("Warning: Skipped {} objects that can't be stored in a scene file.\n", skipped);
+
+    std::vector<uint32_t> order;
+    auto                  top = build_hierarchy(boxes, order, spheres_per_chunk);
+
+    std::vector<chunk_entry> chunks;
+    for (const auto& n : top)
+        if (n.count > 0)
+            chunks.push_back({ n.bounds, 0, 0, 0, n.count });
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << std::format("Error: Couldn't write to '{}'.\n", path);
+        return false;
+    }
+
+    header head = { magic, version, static_cast<uint32_t>(chunks.size()), 0, records.size() };
+    file.write(reinterpret_cast<const char*>(&head), sizeof(head));
+    file.write(reinterpret_cast<const char*>(chunks.data()), chunks.size() * sizeof(chunk_entry));
+
+    size_t chunk_index = 0;
+    for (const auto& n : top) {
+        if (n.count == 0)
+            continue;
+
+        // Sort the chunk's spheres into its own hierarchy.
+        std::vector<aabb> local_boxes;
+        for (uint32_t i = n.offset; i < n.offset + n.count; i++)
+            local_boxes.push_back(boxes[order[i]]);
+
+        std::vector<uint32_t> local_order;
+        auto                  local_nodes = build_hierarchy(local_boxes, local_order, 4);
+
+        std::vector<sphere_record> local_records;
+        for (uint32_t i : local_order)
+            local_records.push_back(records[order[n.offset + i]]);
+
+        auto start = static_cast<uint64_t>(file.tellp());
+        auto pad   = (chunk_alignment - start % chunk_alignment) % chunk_alignment;
+        std::vector<char> zeros(pad);
+        file.write(zeros.data(), zeros.size());
+
+        auto& entry      = chunks[chunk_index++];
+        entry.offset     = start + pad;
+        entry.size       = local_nodes.size() * sizeof(node) + local_records.size() * sizeof(sphere_record);
+        entry.node_count = static_cast<uint32_t>(local_nodes.size());
+
+        file.write(reinterpret_cast<const char*>(local_nodes.data()), local_nodes.size() * sizeof(node));
+        file.write(reinterpret_cast<const char*>(local_records.data()), local_records.size() * sizeof(sphere_record));
+    }
+
+    file.seekp(sizeof(header));
+    file.write(reinterpret_cast<const char*>(chunks.data()), chunks.size() * sizeof(chunk_entry));
+
+    if (!file.good()) {
+        std::cerr << std::format("Error: Failed while writing '{}'.\n", path);
+        return false;
+    }
+
+    std::cerr << std::format("Info: Wrote {} spheres in {} chunks to '{}'.\n", records.size(), chunks.size(), path);
+    return true;
+}
+
+} // namespace scene_file
+
+/*
+ * A scene file rendered straight from disk. Chunks are mapped in when a ray
+ * first needs them and kept in a resident set with a byte budget; the least
+ * recently used chunks are unmapped when it overflows, which keeps the
+ * memory use bounded no matter how large the file is.
+ *
+ * A ray first intersects the chunks that are already resident. Chunks it
+ * would have to page in are deferred until then and skipped if a resident
+ * chunk already produced a closer hit, so most rays never wait on the disk.
+ */
+class out_of_core_scene : public hittable {
+    public:
+        out_of_core_scene(const std::string& path, size_t budget_bytes);
+
+        bool valid() const { return !top.empty(); }
+
+        virtual bool hit(
+            const ray& r,
+            double t_min,
+            double t_max,
+            ray_hit& rec
+        ) const override;
+
+        virtual void surface(const ray& r, const ray_hit& h, hit_record& rec) const override;
+
+        virtual bool bounding_box(aabb& output_box) const override;
+
+        size_t chunk_count() const   { return chunks.size(); }
+        size_t page_ins() const      { return page_in_count; }
+        size_t evictions() const     { return eviction_count; }
+        size_t peak_resident() const { return peak_bytes; }
+
+    private:
+        // Worked out at page-in, as sphere keeps them, for division-free tests.
+        struct sphere_constants {
+            double radius2;
+            double inv_radius;
+        };
+
+        struct resident_chunk {
+            mapped_file                    view;
+            const scene_file::node*          nodes   = nullptr;
+            const scene_file::sphere_record* spheres = nullptr;
+            arena                            mem{ 64 * 1024 };
+            std::vector<material*>           materials;
+            std::vector<sphere_constants>    constants; // per sphere, like materials
+            size_t                           bytes = 0;
+        };
+
+        struct cache_entry {
+            std::shared_ptr<resident_chunk> chunk;
+            std::list<uint32_t>::iterator   where;
+        };
+
+        // The chunk of the thread's last hit, kept for surface() so shading
+        // neither looks it up again nor finds it evicted.
+        struct hit_chunk {
+            const out_of_core_scene*        scene = nullptr;
+            uint32_t                        index = 0;
+            std::shared_ptr<resident_chunk> chunk;
+        };
+
+        static hit_chunk& last_hit()
+        {
+            thread_local hit_chunk slot;
+            return slot;
+        }
+
+        std::shared_ptr<resident_chunk> acquire(uint32_t index) const;
+        std::shared_ptr<resident_chunk> page_in(uint32_t index) const;
+        bool intersect(const resident_chunk& chunk, const ray& r, const vec3& inv_dir, double t_min, double& closest,
+                       uint32_t& best) const;
+
+        std::string                         path;
+        std::vector<scene_file::chunk_entry> chunks;
+        std::vector<scene_file::node>        top;
+        std::vector<uint32_t>                top_order;
+
+        // Resident set
+        size_t                                            budget;
+        std::unique_ptr<std::atomic<bool>[]>              is_resident;
+        mutable std::mutex                                cacheMutex;
+        mutable std::list<uint32_t>                       lru;
+        mutable std::unordered_map<uint32_t, cache_entry> resident;
+        mutable size_t                                    resident_bytes = 0;
+        mutable size_t                                    peak_bytes     = 0;
+        mutable size_t                                    page_in_count  = 0;
+        mutable size_t                                    eviction_count = 0;
+};
+
+out_of_core_scene::out_of_core_scene(const std::string& path, size_t budget_bytes) : path(path), budget(budget_bytes)
+{
+    std::ifstream file(path, std::ios::binary);
+    scene_file::header head = {};
+    if (!file.read(reinterpret_cast<char*>(&head), sizeof(head)) ||
+        head.magic != scene_file::magic || head.version != scene_file::version) {
+        std::cerr << std::format("Error: '{}' isn't a scene file.\n", path);
+        return;
+    }
+
+    // Chunks are mapped without further checks, so everything the table
+    // points at has to be inside the file.
+    file.seekg(0, std::ios::end);
+    const uint64_t file_size = static_cast<uint64_t>(file.tellg());
+    file.seekg(sizeof(head));
+    if (head.chunk_count > (file_size - sizeof(head)) / sizeof(scene_file::chunk_entry)) {
+        std::cerr << std::format("Error: '{}' is truncated.\n", path);
+        return;
+    }
+
+    chunks.resize(head.chunk_count);
+    if (!file.read(reinterpret_cast<char*>(chunks.data()), chunks.size() * sizeof(scene_file::chunk_entry))) {
+        std::cerr << std::format("Error: '{}' is truncated.\n", path);
+        chunks.clear();
+        return;
+    }
+
+    for (const auto& c : chunks) {
+        if (c.offset > file_size || c.size > file_size - c.offset) {
+            std::cerr << std::format("Error: '{}' is truncated.\n", path);
+            chunks.clear();
+            return;
+        }
+        if (uint64_t(c.node_count) * sizeof(scene_file::node) + uint64_t(c.sphere_count) * sizeof(scene_file::sphere_record) >
+            c.size) {
+            std::cerr << std::format("Error: '{}' is damaged.\n", path);
+            chunks.clear();
+            return;
+        }
+    }
+
+    is_resident = std::make_unique<std::atomic<bool>[]>(chunks.size());
+
+    std::vector<aabb> boxes;
+    for (const auto& c : chunks)
+        boxes.push_back(scene_file::to_aabb(c.bounds));
+    top = scene_file::build_hierarchy(boxes, top_order, 1);
+
+    std::cerr << std::format(
+        "Info: Streaming {} spheres in {} chunks from '{}' with {} MiB resident.\n",
+        head.sphere_count, chunks.size(), path, budget >> 20
+    );
+}
+
+std::shared_ptr<out_of_core_scene::resident_chunk> out_of_core_scene::page_in(uint32_t index) const
+{
+    const auto& entry = chunks[index];
+
+    auto chunk  = std::make_shared<resident_chunk>();
+    chunk->view = mapped_file::open(path, entry.offset, entry.size);
+    if (!chunk->view.valid()) {
+        std::cerr << std::format("Error: Couldn't map chunk {} of '{}'.\n", index, path);
+        return nullptr;
+    }
+
+    chunk->nodes   = reinterpret_cast<const scene_file::node*>(chunk->view.data());
+    chunk->spheres = reinterpret_cast<const scene_file::sphere_record*>(chunk->nodes + entry.node_count);
+    if (!scene_file::valid_hierarchy(chunk->nodes, entry.node_count, entry.sphere_count)) {
+        std::cerr << std::format("Error: Chunk {} of '{}' is damaged.\n", index, path);
+        return nullptr;
+    }
+
+    chunk->materials.reserve(entry.sphere_count);
+    chunk->constants.reserve(entry.sphere_count);
+    for (uint32_t i = 0; i < entry.sphere_count; i++) {
+        const auto& s = chunk->spheres[i];
+        color albedo(s.albedo[0], s.albedo[1], s.albedo[2]);
+
+        chunk->constants.push_back({ s.radius * s.radius, 1 / s.radius });
+
+        switch (static_cast<material_kind>(s.kind)) {
+            case material_kind::metal:      chunk->materials.push_back(chunk->mem.create<metal>(albedo, s.param)); break;
+            case material_kind::dielectric: chunk->materials.push_back(chunk->mem.create<dielectric>(s.param, s.albedo[0])); break;
+            default:                        chunk->materials.push_back(chunk->mem.create<lambertian>(albedo)); break;
+        }
+    }
+
+    chunk->bytes = entry.size + chunk->mem.bytes_reserved() + chunk->materials.capacity() * sizeof(material*) +
+                   chunk->constants.capacity() * sizeof(sphere_constants);
+    return chunk;
+}
+
+std::shared_ptr<out_of_core_scene::resident_chunk> out_of_core_scene::acquire(uint32_t index) const
+{
+    {
+        std::unique_lock<std::mutex> lock(cacheMutex);
+        auto it = resident.find(index);
+        if (it != resident.end()) {
+            lru.splice(lru.begin(), lru, it->second.where);
+            return it->second.chunk;
+        }
+    }
+
+    // Map outside the lock so other threads keep rendering meanwhile.
+    auto chunk = page_in(index);
+    if (!chunk)
+        return nullptr;
+
+    std::unique_lock<std::mutex> lock(cacheMutex);
+    auto it = resident.find(index);
+    if (it != resident.end())
+        return it->second.chunk; // Another thread was faster.
+
+    lru.push_front(index);
+    resident[index] = { chunk, lru.begin() };
+    is_resident[index] = true;
+    resident_bytes += chunk->bytes;
+    page_in_count++;
+
+    // Chunks still used by a ray stay alive until it lets go of them.
+    while (resident_bytes > budget && lru.size() > 1) {
+        uint32_t victim = lru.back();
+        lru.pop_back();
+        resident_bytes -= resident[victim].chunk->bytes;
+        is_resident[victim] = false;
+        resident.erase(victim);
+        eviction_count++;
+    }
+
+    peak_bytes = std::max(peak_bytes, resident_bytes);
+    return chunk;
+}
+
+bool out_of_core_scene::intersect(const resident_chunk& chunk, const ray& r, const vec3& inv_dir, double t_min,
+                                  double& closest, uint32_t& best) const
+{
+    const point3 origin = r.origin();
+    bool         found  = false;
+    double       t_near;
+
+    uint32_t stack[64];
+    int      stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0) {
+        const auto& n = chunk.nodes[stack[--stack_size]];
+        if (!scene_file::hit_box(n.bounds, origin, inv_dir, t_min, closest, t_near))
+            continue;
+
+        if (n.count == 0) {
+            assert(stack_size + 2 <= 64);
+            stack[stack_size++] = n.offset + 1;
+            stack[stack_size++] = n.offset;
+            continue;
+        }
+
+        // Same math as sphere::hit().
+        for (uint32_t i = n.offset; i < n.offset + n.count; i++) {
+            const auto& s      = chunk.spheres[i];
+            vec3        oc     = origin - point3(s.center[0], s.center[1], s.center[2]);
+            auto        half_b = dot(oc, r.direction());
+            auto        c      = oc.length_squared() - chunk.constants[i].radius2;
+
+            auto discriminant = (half_b * half_b) - c;
+            if (discriminant < 0)
+                continue;
+
+            auto sqrtd = sqrt(discriminant);
+            auto root  = -half_b - sqrtd;
+            if (root < t_min || closest < root) {
+                root = -half_b + sqrtd;
+                if (root < t_min || closest < root)
+                    continue;
+            }
+
+            closest = root;
+            best    = i;
+            found   = true;
+        }
+    }
+
+    return found;
+}
+
+bool out_of_core_scene::hit(const ray& r, double t_min, double t_max, ray_hit& rec) const
+{
+    if (top.empty())
+        return false;
+
+    const point3 origin  = r.origin();
+    const vec3   inv_dir = r.inv_direction();
+
+    double                          closest     = t_max;
+    bool                            found       = false;
+    uint32_t                        best_chunk  = 0;
+    uint32_t                        best_sphere = 0;
+    std::shared_ptr<resident_chunk> best;
+
+    struct deferred {
+        uint32_t chunk;
+        double   t_near;
+    };
+    deferred later[64];
+    int      later_count = 0;
+
+    auto test_chunk = [&](uint32_t index) {
+        auto chunk = acquire(index);
+        if (chunk && intersect(*chunk, r, inv_dir, t_min, closest, best_sphere)) {
+            found      = true;
+            best_chunk = index;
+            best       = std::move(chunk);
+        }
+    };
+
+    uint32_t stack[64];
+    int      stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0) {
+        const auto& n = top[stack[--stack_size]];
+        double      t_near;
+        if (!scene_file::hit_box(n.bounds, origin, inv_dir, t_min, closest, t_near))
+            continue;
+
+        if (n.count == 0) {
+            assert(stack_size + 2 <= 64);
+            stack[stack_size++] = n.offset + 1;
+            stack[stack_size++] = n.offset;
+            continue;
+        }
+
+        for (uint32_t i = n.offset; i < n.offset + n.count; i++) {
+            uint32_t index = top_order[i];
+            if (is_resident[index] || later_count == 64)
+                test_chunk(index);
+            else
+                later[later_count++] = { index, t_near };
+        }
+    }
+
+    // Page in only what can still beat the closest resident hit, nearest first.
+    std::sort(later, later + later_count, [](const deferred& a, const deferred& b) { return a.t_near < b.t_near; });
+    for (int i = 0; i < later_count && later[i].t_near <= closest; i++)
+        test_chunk(later[i].chunk);
+
+    if (!found)
+        return false;
+
+    rec.t      = closest;
+    rec.object = this;
+    rec.group  = best_chunk;
+    rec.index  = best_sphere;
+    last_hit() = { this, best_chunk, std::move(best) };
+    return true;
+}
+
+void out_of_core_scene::surface(const ray& r, const ray_hit& h, hit_record& rec) const
+{
+    // The kernels shade a hit right after finding it, on the same thread;
+    // anything else looks the chunk up again. The record holds on to it
+    // until the hit is shaded.
+    auto&                           slot  = last_hit();
+    std::shared_ptr<resident_chunk> chunk = slot.scene == this && slot.index == h.group ? std::move(slot.chunk) : acquire(h.group);
+    slot.scene = nullptr;
+
+    rec.t     = h.t;
+    rec.point = r.at(rec.t);
+    if (!chunk) {
+        static const lambertian unmapped(color(0, 0, 0));
+        rec.mat_ptr = &unmapped;
+        rec.set_face_normal(r, -r.direction());
+        return;
+    }
+
+    const auto& s      = chunk->spheres[h.index];
+    point3      center = point3(s.center[0], s.center[1], s.center[2]);
+
+    rec.mat_ptr = chunk->materials[h.index];
+    rec.set_face_normal(r, (rec.point - center) * chunk->constants[h.index].inv_radius);
+    rec.owner   = std::move(chunk);
+}
+
+bool out_of_core_scene::bounding_box(aabb& output_box) const
+{
+    if (top.empty())
+        return false;
+
+    output_box = scene_file::to_aabb(top[0].bounds);
+    return true;
+}
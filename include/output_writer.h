@@ -0,0 +1,107 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <format>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common.h"
+#include "config.h"
+#include "image.h"
+
+/*
+ * Encodes and saves finished images on a thread of its own, so rendering
+ * goes on with the next frame (or view) meanwhile. Images are copied into
+ * the queue; at most 'capacity' of them wait at a time and write_ppm()
+ * blocks until there is room, which bounds the memory held by the queue.
+ * The destructor finishes everything still queued.
+ */
+class output_writer {
+    public:
+        explicit output_writer(size_t capacity = 2) : capacity(capacity > 0 ? capacity : 1)
+        {
+            worker = std::thread([this] { run(); });
+        }
+
+        ~output_writer()
+        {
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                stopping = true;
+            }
+            queueChanged.notify_all();
+            worker.join();
+        }
+
+        output_writer(const output_writer&) = delete;
+        output_writer& operator=(const output_writer&) = delete;
+
+        void write_ppm(const color* pixels, const Prefs& prefs, const std::string& path)
+        {
+            const size_t count = static_cast<size_t>(prefs.image_width) * prefs.image_height;
+            write_ppm(std::vector<color>(pixels, pixels + count), prefs, path);
+        }
+
+        void write_ppm(std::vector<color> pixels, const Prefs& prefs, const std::string& path)
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueChanged.wait(lock, [&] { return jobs.size() < capacity; });
+            jobs.push_back({ std::move(pixels), prefs.image_width, prefs.image_height, prefs.samples_per_pixel, path });
+            queueChanged.notify_all();
+        }
+
+        // Waits until everything queued so far is on disk.
+        void flush()
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueChanged.wait(lock, [&] { return jobs.empty() && !busy; });
+        }
+
+    private:
+        struct job {
+            std::vector<color> pixels;
+            int                width;
+            int                height;
+            int                samples_per_pixel;
+            std::string        path;
+        };
+
+        void run()
+        {
+            while (true) {
+                job next;
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    queueChanged.wait(lock, [&] { return stopping || !jobs.empty(); });
+                    if (jobs.empty())
+                        return;
+
+                    next = std::move(jobs.front());
+                    jobs.pop_front();
+                    busy = true;
+                }
+                queueChanged.notify_all();
+
+                auto data = encode_ppm(next.pixels.data(), next.width, next.height, next.samples_per_pixel);
+                next.pixels = {};
+                if (write_file(data, next.path.c_str()))
+                    std::cerr << std::format("Info: Saved output to '{}'.\n", next.path);
+
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    busy = false;
+                }
+                queueChanged.notify_all();
+            }
+        }
+
+        size_t                  capacity;
+        std::mutex              queueMutex;
+        std::condition_variable queueChanged;
+        std::deque<job>         jobs;
+        bool                    busy     = false;
+        bool                    stopping = false;
+        std::thread             worker;
+};
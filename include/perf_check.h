@@ -0,0 +1,280 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "arena.h"
+#include "bvh.h"
+#include "camera.h"
+#include "config.h"
+#include "grid.h"
+#include "hittable_list.h"
+#include "image.h"
+#include "kernel.h"
+#include "render.h"
+#include "scene.h"
+
+/*
+ * Performance and correctness check for CI and before sending changes off.
+ * A few fixed reference renders of the cover scene (through the BVH, the
+ * grid and the plain object list) are timed several times on one thread,
+ * each run repeating its render until it has lasted long enough to time.
+ * The best throughput in Mrays/s is compared with a stored baseline, since
+ * interference only ever slows a run down: a case that got slower by more
+ * than the tolerance is measured again (keeping the best rate of all
+ * measurements), and fails only if it is still slower after the retries.
+ * The image of every case is compared with a reference image by RMSE,
+ * which catches changes that speed things up by rendering something else.
+ *
+ * Timings depend on the machine, so the baseline lives in the working
+ * directory and the first run records it. The reference images are part of
+ * the source tree; a missing one is a failure, and only --perf-update
+ * writes them (and replaces the baseline). Returns non-zero if any case
+ * failed.
+ */
+namespace perf {
+
+constexpr const char* baseline_path = "perf_baseline.cfg";
+constexpr double      tolerance     = 0.10; // relative slowdown that counts as a regression
+constexpr double      min_run_time  = 0.25; // seconds, a timed run repeats its render until then
+constexpr int         retries       = 2;    // extra measurements before a slow case fails
+constexpr double      max_rmse      = 0.5;  // in 8-bit steps
+
+enum class accel { bvh, grid, list };
+
+struct test_case {
+    const char* name;
+    accel       structure;
+    int         width;
+    int         samples_per_pixel;
+};
+
+// Sized to take a few hundred milliseconds per render.
+constexpr test_case cases[] = {
+    { "bvh",  accel::bvh,  320, 4 },
+    { "grid", accel::grid, 320, 4 },
+    { "list", accel::list, 48,  2 },
+};
+
+struct summary {
+    double best   = 0;
+    double mean   = 0;
+    double stddev = 0;
+    int    runs   = 0;
+
+    // Half width of the 95% confidence interval of the mean (Student's t).
+    double margin() const
+    {
+        static constexpr double t95[] = {
+            12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+            2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        };
+        if (runs < 2)
+            return 0;
+        double t = runs - 2 < 20 ? t95[runs - 2] : 1.96;
+        return t * stddev / std::sqrt(runs);
+    }
+
+    static summary of(const std::vector<double>& values)
+    {
+        summary s;
+        s.runs = static_cast<int>(values.size());
+        for (double v : values) {
+            s.best  = std::max(s.best, v);
+            s.mean += v / s.runs;
+        }
+        for (double v : values)
+            s.stddev += (v - s.mean) * (v - s.mean);
+        s.stddev = s.runs > 1 ? std::sqrt(s.stddev / (s.runs - 1)) : 0;
+        return s;
+    }
+};
+
+inline std::map<std::string, summary> read_baseline(const char* path)
+{
+    std::map<std::string, summary> result;
+    std::ifstream                  file(path);
+    std::string                    line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream in(line);
+        std::string        name;
+        summary            s;
+        if (in >> name >> s.best >> s.mean >> s.stddev >> s.runs)
+            result[name] = s;
+    }
+    return result;
+}
+
+// 8-bit values of a plain PPM as written by encode_ppm().
+struct ppm_values {
+    int              width  = 0;
+    int              height = 0;
+    std::vector<int> values;
+
+    bool read(std::istream& in)
+    {
+        std::string magic;
+        int         max_value;
+        if (!(in >> magic) || magic != "P3")
+            return false;
+
+        // Header comments run to the end of the line.
+        while (in >> std::ws && in.peek() == '#')
+            in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        if (!(in >> width >> height >> max_value))
+            return false;
+
+        values.resize(static_cast<size_t>(width) * height * 3);
+        for (auto& v : values)
+            if (!(in >> v))
+                return false;
+        return true;
+    }
+};
+
+inline double rmse(const std::vector<int>& a, const std::vector<int>& b)
+{
+    double sum = 0;
+    for (size_t i = 0; i < a.size(); i++)
+        sum += static_cast<double>(a[i] - b[i]) * (a[i] - b[i]);
+    return std::sqrt(sum / a.size());
+}
+
+inline int run(int runs, bool update, const std::filesystem::path& reference_dir)
+{
+    arena mem;
+    seed_random(1234);
+    auto world = random_scene(mem, false);
+    bvh  tree(world.objects);
+    uniform_grid grid(world.objects);
+
+    auto                           baseline = update ? std::map<std::string, summary>{} : read_baseline(baseline_path);
+    std::map<std::string, summary> measured;
+    bool                           failed = false;
+
+    for (const auto& c : cases) {
+        Prefs prefs             = default_prefs();
+        prefs.aspect_ratio      = 16.0 / 9.0;
+        prefs.image_width       = c.width;
+        prefs.image_height      = static_cast<int>(c.width / prefs.aspect_ratio);
+        prefs.samples_per_pixel = c.samples_per_pixel;
+        prefs.max_depth         = 50;
+        prefs.sampler           = sampler_type::sobol;
+        prefs.seed              = 7;
+
+        const hittable& root = c.structure == accel::bvh ? static_cast<const hittable&>(tree)
+                             : c.structure == accel::grid ? static_cast<const hittable&>(grid)
+                                                          : world;
+
+        camera             cam(default_camera(prefs.aspect_ratio, 0));
+        const size_t       count = static_cast<size_t>(prefs.image_width) * prefs.image_height;
+        std::vector<color> pixels(count);
+
+        auto measure = [&] {
+            std::vector<double> rates;
+
+            // One extra run first to warm up caches and page in the tables.
+            for (int r = 0; r <= runs; r++) {
+                auto  rays  = rays_traced();
+                auto  start = std::chrono::steady_clock::now();
+                std::chrono::duration<double> time{};
+
+                do {
+                    auto  smp = make_sampler(prefs.sampler, prefs.samples_per_pixel, prefs.seed);
+                    auto* row = scratch_arena().allocate_array<pixel_result>(prefs.image_width);
+                    for (int y = 0; y < prefs.image_height; y++) {
+                        render_span(prefs, cam, root, 0, y, prefs.image_width, 0, prefs.samples_per_pixel, row, *smp);
+                        for (int x = 0; x < prefs.image_width; x++)
+                            pixels[static_cast<size_t>(y) * prefs.image_width + x] = row[x].beauty;
+                    }
+                    scratch_arena().reset();
+                    time = std::chrono::steady_clock::now() - start;
+                } while (time.count() < min_run_time);
+
+                if (r > 0)
+                    rates.push_back((rays_traced() - rays) / time.count() / 1e6);
+            }
+            return summary::of(rates);
+        };
+
+        auto now = measure();
+
+        std::string verdict = "recorded";
+        auto        it      = baseline.find(c.name);
+        if (it != baseline.end()) {
+            const auto& base   = it->second;
+            auto        slower = [&] { return now.best < (1 - tolerance) * base.best; };
+            for (int retry = 0; retry < retries && slower(); retry++) {
+                std::cerr << std::format("Info: {}: {:.3f} Mrays/s looks slow, measuring again.\n", c.name, now.best);
+                auto again = measure();
+                if (again.best > now.best)
+                    now = again;
+            }
+            verdict = std::format("{:+.1f}% vs {:.3f}{}", 100 * (now.best / base.best - 1), base.best, slower() ? ", SLOWER" : "");
+            failed |= slower();
+        }
+        measured[c.name] = now;
+
+        std::cerr << std::format(
+            "Info: {}: best {:.3f}, mean {:.3f} +- {:.3f} Mrays/s ({})\n", c.name, now.best, now.mean, now.margin(), verdict
+        );
+
+        // The image is the same on every run, so the last one stands for all.
+        const std::string reference = (reference_dir / std::format("perf_{}.ppm", c.name)).string();
+        const std::string encoded   = encode_ppm(pixels.data(), prefs.image_width, prefs.image_height, prefs.samples_per_pixel);
+
+        if (update) {
+            std::error_code error;
+            std::filesystem::create_directories(reference_dir, error);
+            write_file(encoded, reference.c_str());
+            continue;
+        }
+
+        std::ifstream file(reference);
+        ppm_values    expected;
+        if (!expected.read(file)) {
+            std::cerr << std::format("Error: Couldn't read the reference image '{}', record it with --perf-update.\n", reference);
+            failed = true;
+            continue;
+        }
+
+        std::istringstream in(encoded);
+        ppm_values         actual;
+        actual.read(in);
+        if (expected.width != actual.width || expected.height != actual.height) {
+            std::cerr << std::format("Error: '{}' has a different resolution, rerun with --perf-update.\n", reference);
+            failed = true;
+            continue;
+        }
+
+        double error = rmse(expected.values, actual.values);
+        if (error > max_rmse) {
+            std::cerr << std::format("Error: {} image differs from '{}' (RMSE {:.3f}).\n", c.name, reference, error);
+            failed = true;
+        }
+    }
+
+    if (baseline.empty()) {
+        std::ofstream file(baseline_path);
+        file << "# case  best Mrays/s  mean Mrays/s  standard deviation  runs\n";
+        for (const auto& [name, s] : measured)
+            file << std::format("{} {} {} {} {}\n", name, s.best, s.mean, s.stddev, s.runs);
+        std::cerr << std::format("Info: Saved the baseline to '{}'.\n", baseline_path);
+    }
+
+    std::cerr << (failed ? "Error: Performance check failed.\n" : "Info: Performance check passed.\n");
+    return failed ? 1 : 0;
+}
+
+} // namespace perf
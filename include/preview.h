@@ -0,0 +1,170 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "arena.h"
+#include "camera.h"
+#include "config.h"
+#include "mapped_file.h"
+#include "render.h"
+#include "thread_pool.h"
+
+/*
+ * Interactive preview. The frame is rendered in passes of one sample per
+ * pixel; after every pass the averaged image is written into a memory
+ * mapped binary PPM that viewers can keep open (or map themselves). The
+ * header carries the pass number, which is updated after the pixels.
+ *
+ * The camera comes from a small text file that is watched while rendering.
+ * Saving it cancels the running pass and starts over from the new view;
+ * deleting it ends the preview.
+ */
+
+// "lookfrom x y z  lookat x y z  vfov" on one line.
+inline bool read_view(const char* path, camera_params& view)
+{
+    std::ifstream file(path);
+    double fx, fy, fz, ax, ay, az, vfov;
+    if (!(file >> fx >> fy >> fz >> ax >> ay >> az >> vfov))
+        return false;
+
+    view.lookfrom = point3(fx, fy, fz);
+    view.lookat   = point3(ax, ay, az);
+    view.vfov     = vfov;
+    return true;
+}
+
+inline void write_view(const char* path, const camera_params& view)
+{
+    std::ofstream file(path);
+    file << std::format(
+        "{} {} {}  {} {} {}  {}\n",
+        view.lookfrom.x(), view.lookfrom.y(), view.lookfrom.z(),
+        view.lookat.x(), view.lookat.y(), view.lookat.z(),
+        view.vfov
+    );
+}
+
+// Fixed length, so the pass number can be rewritten in place.
+inline std::string preview_header(int width, int height, int pass)
+{
+    return std::format("P6\n# pass {:010}\n{} {}\n255\n", pass, width, height);
+}
+
+inline void run_preview(const Prefs& prefs, const hittable& world, camera_params view, thread_pool* pool,
+                        const std::string& path)
+{
+    constexpr const char* view_path = "view.cfg";
+
+    const int    width  = prefs.image_width;
+    const int    height = prefs.image_height;
+    const size_t count  = static_cast<size_t>(width) * height;
+
+    if (!read_view(view_path, view))
+        write_view(view_path, view);
+
+    const size_t header = preview_header(width, height, 0).size();
+    auto         fb     = mapped_file::create(path, header + count * 3);
+    if (!fb.valid()) {
+        std::cerr << std::format("Error: Couldn't map '{}'.\n", path);
+        return;
+    }
+    std::memcpy(fb.data(), preview_header(width, height, 0).data(), header);
+
+    std::atomic<bool> restart = false;
+    std::atomic<bool> stop    = false;
+
+    std::thread watcher([&] {
+        std::error_code error;
+        auto last = std::filesystem::last_write_time(view_path, error);
+        while (!stop) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+            auto time = std::filesystem::last_write_time(view_path, error);
+            if (error) {
+                stop    = true;
+                restart = true;
+            } else if (time != last) {
+                last    = time;
+                restart = true;
+            }
+        }
+    });
+
+    std::cerr << std::format(
+        "Info: Previewing into '{}'. Edit '{}' to move the camera, delete it to stop.\n", path, view_path
+    );
+
+    camera             cam(view);
+    std::vector<color> accum(count);
+    int                passes = 0;
+
+    while (!stop) {
+        if (restart.exchange(false)) {
+            if (stop)
+                break;
+            if (!read_view(view_path, view))
+                continue; // Probably caught mid-save; the next change restarts again.
+
+            cam    = camera(view);
+            passes = 0;
+            std::fill(accum.begin(), accum.end(), color(0, 0, 0));
+            std::cerr << "\nInfo: View changed, restarting.\n";
+        }
+
+        if (passes >= prefs.samples_per_pixel) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        parallel_for(pool, 0, height, 1, [&](size_t y) {
+            if (restart)
+                return;
+
+            auto& scratch = scratch_arena();
+            auto* row     = scratch.allocate_array<pixel_result>(width);
+            auto  smp     = make_sampler(prefs.sampler, prefs.samples_per_pixel, prefs.seed);
+            render_span(prefs, cam, world, 0, static_cast<int>(y), width, passes, 1, row, *smp);
+
+            for (int x = 0; x < width; x++)
+                accum[y * width + x] += row[x].beauty;
+            scratch.reset();
+        });
+
+        // A cancelled pass is incomplete; the accumulation is reset above.
+        if (restart)
+            continue;
+        passes++;
+
+        // Resolve with the same gamma and clamping as write_as_ppm, top row first.
+        auto*        pixels = reinterpret_cast<unsigned char*>(fb.data() + header);
+        const double scale  = 1.0 / passes;
+        parallel_for(pool, 0, height, 8, [&](size_t row) {
+            const color* src = accum.data() + (height - 1 - row) * width;
+            for (int x = 0; x < width; x++)
+                for (int c = 0; c < 3; c++)
+                    pixels[(row * width + x) * 3 + c] = static_cast<unsigned char>(256 * clamp(sqrt(fmax(0.0, scale * src[x][c])), 0.0, 0.999));
+        });
+
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(fb.data(), preview_header(width, height, passes).data(), header);
+
+        auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cerr << std::format("\rPass {}/{} ({}ms) ", passes, prefs.samples_per_pixel, time.count());
+        std::cerr << std::flush;
+    }
+
+    stop = true;
+    watcher.join();
+    std::cerr << "\nInfo: View file removed, stopping the preview.\n";
+}
@@ -3,14 +3,21 @@
 
 #include "vec3.h"
 
+/*
+ * The direction is stored with unit length, so 't' is the distance along
+ * the ray, and with its reciprocal for slab tests. Both are worked out once
+ * here rather than in every intersection test.
+ */
 class ray {
     public:
         ray() {}
-        ray(const point3& origin, const vec3& direction) 
-            : org(origin), dir(direction) {}
+        ray(const point3& origin, const vec3& direction, double time = 0.0) 
+            : org(origin), dir(unit_vector(direction)), inv_dir(1 / dir.x(), 1 / dir.y(), 1 / dir.z()), tm(time) {}
 
         point3 origin() const  { return org; }
         vec3 direction() const { return dir; }
+        vec3 inv_direction() const { return inv_dir; }
+        double time() const    { return tm; }
 
         point3 at(double t) const
         {
@@ -20,6 +27,8 @@ class ray {
     public:
         point3 org;
         vec3 dir;
+        vec3 inv_dir;
+        double tm;
 };
 
 #endif // RAY_H
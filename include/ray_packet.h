@@ -0,0 +1,124 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include "aabb.h"
+#include "ray.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
+/*
+ * A group of rays traced together through the BVH. Origins, reciprocal
+ * directions and the current closest hit are kept as separate arrays so the
+ * box test over all lanes compiles to vector code. Lanes are selected with
+ * a bit mask; primitives are still intersected one ray at a time.
+ */
+struct ray_packet {
+    static constexpr int width = 8;
+
+    using mask = uint32_t;
+    static constexpr mask all_lanes = (1u << width) - 1;
+
+    ray    rays[width];
+    double ox[width], oy[width], oz[width];
+    double ix[width], iy[width], iz[width];
+    double t_max[width];
+
+    void set(int lane, const ray& r, double t = infinity)
+    {
+        rays[lane]  = r;
+        ox[lane]    = r.origin().x();
+        oy[lane]    = r.origin().y();
+        oz[lane]    = r.origin().z();
+        ix[lane]    = r.inv_direction().x();
+        iy[lane]    = r.inv_direction().y();
+        iz[lane]    = r.inv_direction().z();
+        t_max[lane] = t;
+    }
+
+    // Lanes whose directions point into the same octant as most of the
+    // packet. Rays outside it would drag the packet into unrelated subtrees.
+    mask coherent_lanes() const
+    {
+        int count[8] = {};
+        int octant[width];
+        for (int k = 0; k < width; k++) {
+            octant[k] = (ix[k] < 0) | (iy[k] < 0) << 1 | (iz[k] < 0) << 2;
+            count[octant[k]]++;
+        }
+
+        int major = 0;
+        for (int o = 1; o < 8; o++)
+            major = count[o] > count[major] ? o : major;
+
+        mask lanes = 0;
+        for (int k = 0; k < width; k++)
+            lanes |= static_cast<mask>(octant[k] == major) << k;
+        return lanes;
+    }
+
+    /*
+     * Whether any lane in 'lanes' hits the box, testing one lane at a time
+     * and starting with the one that hit last time. For a coherent packet
+     * this usually costs a single slab test.
+     */
+    bool any_hit(const aabb& box, double t_min, mask lanes, int& first, double& t_near) const
+    {
+        if (lanes >> first & 1 && hit_lane(box, t_min, first, t_near))
+            return true;
+
+        for (mask m = lanes & ~(1u << first); m; m &= m - 1) {
+            int k = std::countr_zero(m);
+            if (hit_lane(box, t_min, k, t_near)) {
+                first = k;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool hit_lane(const aabb& box, double t_min, int k, double& t_near) const
+    {
+        return box.hit(point3(ox[k], oy[k], oz[k]), vec3(ix[k], iy[k], iz[k]), t_min, t_max[k], t_near);
+    }
+
+    /* Slab test of every lane in 'lanes'; returns the lanes that hit and the nearest entry among them. */
+    mask hit(const aabb& box, double t_min, mask lanes, double& t_nearest) const
+    {
+        double entry[width];
+        double gap[width];
+
+        // Only min/max and plain arithmetic, so the loop vectorizes. Apart
+        // from rays lying exactly in a slab plane this agrees with aabb::hit().
+        for (int k = 0; k < width; k++) {
+            double x0 = (box.minimum.x() - ox[k]) * ix[k], x1 = (box.maximum.x() - ox[k]) * ix[k];
+            double y0 = (box.minimum.y() - oy[k]) * iy[k], y1 = (box.maximum.y() - oy[k]) * iy[k];
+            double z0 = (box.minimum.z() - oz[k]) * iz[k], z1 = (box.maximum.z() - oz[k]) * iz[k];
+
+            double near = t_min, far = t_max[k];
+            near = std::max(near, std::min(x0, x1));
+            far  = std::min(far,  std::max(x0, x1));
+            near = std::max(near, std::min(y0, y1));
+            far  = std::min(far,  std::max(y0, y1));
+            near = std::max(near, std::min(z0, z1));
+            far  = std::min(far,  std::max(z0, z1));
+
+            entry[k] = near;
+            gap[k]   = far - near;
+        }
+
+        mask result = 0;
+        t_nearest   = infinity;
+        for (int k = 0; k < width; k++) {
+            if (gap[k] >= 0 && (lanes >> k & 1)) {
+                result   |= 1u << k;
+                t_nearest = entry[k] < t_nearest ? entry[k] : t_nearest;
+            }
+        }
+
+        return result;
+    }
+};
+
+#endif // RAY_PACKET_H
@@ -0,0 +1,343 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include "arena.h"
+#include "camera.h"
+#include "config.h"
+#include "image.h"
+#include "render.h"
+#include "thread_pool.h"
+
+/*
+ * Partial re-renders. The sample sums and counts of every pixel are kept in
+ * an accumulation file between runs; a run renders only the selected pixels
+ * (a crop window, a mask image, or both) with 'samples per pixel' more
+ * samples each and adds them to the file. Touching up a fireflied area thus
+ * costs time in proportion to its size, and repeated touch-ups keep
+ * refining the same estimate: every pixel continues its sample sequence
+ * where the previous run stopped. The file records what the samples were
+ * rendered with (seed, sampler, path depth, spectral mode, shutter and the
+ * extent of the scene), and runs with other settings are refused rather
+ * than mixed into the same sums.
+ *
+ * Like the render buffers, pixels are stored bottom row first.
+ */
+
+/* What the samples of an accumulation file were rendered with. */
+struct accumulation_settings {
+    int32_t  seed;
+    uint32_t sampler;
+    int32_t  max_depth;
+    uint32_t spectral;
+    double   shutter;
+    double   scene_min[3];
+    double   scene_max[3];
+
+    static accumulation_settings of(const Prefs& prefs, const hittable& world)
+    {
+        accumulation_settings settings = {};
+        settings.seed      = prefs.seed;
+        settings.sampler   = static_cast<uint32_t>(prefs.sampler);
+        settings.max_depth = prefs.max_depth;
+        settings.spectral  = prefs.spectral;
+        settings.shutter   = prefs.shutter;
+
+        aabb box;
+        if (world.bounding_box(box)) {
+            for (int a = 0; a < 3; a++) {
+                settings.scene_min[a] = box.min()[a];
+                settings.scene_max[a] = box.max()[a];
+            }
+        }
+        return settings;
+    }
+
+    // The first setting that differs from 'other', or nullptr.
+    const char* mismatch(const accumulation_settings& other) const
+    {
+        if (seed != other.seed)
+            return "seed";
+        if (sampler != other.sampler)
+            return "sampler";
+        if (max_depth != other.max_depth)
+            return "max depth";
+        if (spectral != other.spectral)
+            return "spectral mode";
+        if (shutter != other.shutter)
+            return "shutter";
+        if (!std::equal(scene_min, scene_min + 3, other.scene_min) || !std::equal(scene_max, scene_max + 3, other.scene_max))
+            return "scene";
+        return nullptr;
+    }
+};
+
+struct accumulation_buffer {
+    static constexpr char     magic[8] = { 'S', 'R', 'T', 'A', 'C', 'C', 'U', 'M' };
+    static constexpr uint32_t version  = 3;
+
+    struct header {
+        char                  magic[8];
+        uint32_t              version;
+        int32_t               width;
+        int32_t               height;
+        uint32_t              reserved;
+        accumulation_settings settings;
+    };
+
+    int                   width  = 0;
+    int                   height = 0;
+    accumulation_settings settings;
+    std::vector<double>   sums;   // r, g, b per pixel
+    std::vector<uint32_t> counts; // samples per pixel
+
+    accumulation_buffer(int width, int height, const accumulation_settings& settings)
+        : width(width), height(height), settings(settings), sums(static_cast<size_t>(width) * height * 3),
+          counts(static_cast<size_t>(width) * height)
+    {
+    }
+
+    size_t pixel_count() const { return counts.size(); }
+
+    /*
+     * Reads 'path' if it exists; an existing file of another size, or
+     * rendered with other settings, is an error.
+     */
+    bool load(const std::string& path, bool& found)
+    {
+        std::ifstream file(path, std::ios::binary);
+        found = file.is_open();
+        if (!found)
+            return true;
+
+        header head = {};
+        if (!file.read(reinterpret_cast<char*>(&head), offsetof(header, settings)) ||
+            !std::equal(head.magic, head.magic + 8, magic)) {
+            std::cerr << std::format("Error: '{}' isn't an accumulation file.\n", path);
+            return false;
+        }
+        if (head.version != version) {
+            std::cerr << std::format("Error: '{}' is from another version of the renderer, start a new one.\n", path);
+            return false;
+        }
+        if (!file.read(reinterpret_cast<char*>(&head.settings), sizeof(head.settings))) {
+            std::cerr << std::format("Error: '{}' is truncated.\n", path);
+            return false;
+        }
+        if (head.width != width || head.height != height) {
+            std::cerr << std::format(
+                "Error: '{}' holds a {}x{} image, but the render is {}x{}.\n", path, head.width, head.height, width, height
+            );
+            return false;
+        }
+        if (auto setting = head.settings.mismatch(settings)) {
+            std::cerr << std::format("Error: '{}' was rendered with another {}, it can't be added to.\n", path, setting);
+            return false;
+        }
+
+        if (!file.read(reinterpret_cast<char*>(sums.data()), sums.size() * sizeof(double)) ||
+            !file.read(reinterpret_cast<char*>(counts.data()), counts.size() * sizeof(uint32_t))) {
+            std::cerr << std::format("Error: '{}' is truncated.\n", path);
+            return false;
+        }
+        return true;
+    }
+
+    bool save(const std::string& path) const
+    {
+        header head = {};
+        std::copy(magic, magic + 8, head.magic);
+        head.version  = version;
+        head.width    = width;
+        head.height   = height;
+        head.settings = settings;
+
+        std::ofstream file(path, std::ios::binary);
+        if (!file.write(reinterpret_cast<const char*>(&head), sizeof(head)) ||
+            !file.write(reinterpret_cast<const char*>(sums.data()), sums.size() * sizeof(double)) ||
+            !file.write(reinterpret_cast<const char*>(counts.data()), counts.size() * sizeof(uint32_t))) {
+            std::cerr << std::format("Error: Couldn't write to '{}'.\n", path);
+            return false;
+        }
+        return true;
+    }
+
+    /*
+     * The pixel averages scaled to the smallest sample count, which is the
+     * count encode_ppm() divides by and records. Pixels without samples stay
+     * black.
+     */
+    std::vector<color> resolve(int& samples_per_pixel) const
+    {
+        uint32_t least = 0;
+        for (auto c : counts)
+            if (c > 0 && (least == 0 || c < least))
+                least = c;
+        samples_per_pixel = std::max<uint32_t>(least, 1);
+
+        std::vector<color> pixels(pixel_count());
+        for (size_t i = 0; i < pixels.size(); i++)
+            if (counts[i] > 0)
+                pixels[i] = (static_cast<double>(samples_per_pixel) / counts[i]) * color(sums[3 * i], sums[3 * i + 1], sums[3 * i + 2]);
+        return pixels;
+    }
+};
+
+/*
+ * Reads a PGM or PPM (plain or binary) of the image's size; pixels that
+ * aren't black are selected. 'selected' is stored bottom row first.
+ */
+inline bool read_pixel_mask(const std::string& path, int width, int height, std::vector<uint8_t>& selected)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string   magic;
+    if (!file.is_open()) {
+        std::cerr << std::format("Error: Couldn't open the mask '{}'.\n", path);
+        return false;
+    }
+    if (!(file >> magic) || (magic != "P2" && magic != "P3" && magic != "P5" && magic != "P6")) {
+        std::cerr << std::format("Error: '{}' isn't a PGM or PPM image.\n", path);
+        return false;
+    }
+
+    auto skip_comments = [&] {
+        while (file >> std::ws && file.peek() == '#')
+            file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    };
+
+    int w, h, max_value;
+    skip_comments();
+    file >> w;
+    skip_comments();
+    file >> h;
+    skip_comments();
+    file >> max_value;
+    if (!file || w != width || h != height || max_value <= 0 || max_value > 255) {
+        std::cerr << std::format("Error: The mask '{}' must be an 8-bit {}x{} image.\n", path, width, height);
+        return false;
+    }
+    file.get(); // the single whitespace before binary pixels
+
+    const int  channels = magic == "P3" || magic == "P6" ? 3 : 1;
+    const bool binary   = magic == "P5" || magic == "P6";
+
+    selected.assign(static_cast<size_t>(width) * height, 0);
+    for (int row = 0; row < height; row++) {
+        uint8_t* out = selected.data() + static_cast<size_t>(height - 1 - row) * width;
+        for (int x = 0; x < width * channels; x++) {
+            int value;
+            if (binary)
+                value = file.get();
+            else
+                file >> value;
+            if (!file) {
+                std::cerr << std::format("Error: The mask '{}' is truncated.\n", path);
+                return false;
+            }
+            out[x / channels] |= value != 0;
+        }
+    }
+    return true;
+}
+
+/*
+ * Renders the selected pixels (all of them without crop and mask) into the
+ * accumulation file and writes the merged image to 'output'. Returns false
+ * on errors, before anything is rendered.
+ */
+inline bool render_region(const Prefs& prefs, const camera& cam, const hittable& world, thread_pool* pool,
+                          const std::string& accum_path, const crop_window& crop, const std::string& mask_path,
+                          const std::string& output)
+{
+    const int width  = prefs.image_width;
+    const int height = prefs.image_height;
+
+    std::vector<uint8_t> selected(static_cast<size_t>(width) * height, 1);
+    if (!mask_path.empty() && !read_pixel_mask(mask_path, width, height, selected))
+        return false;
+
+    if (!crop.empty()) {
+        int x0 = std::clamp(crop.x, 0, width), x1 = std::clamp(crop.x + crop.width, 0, width);
+        int y0 = std::clamp(crop.y, 0, height), y1 = std::clamp(crop.y + crop.height, 0, height);
+        for (int j = 0; j < height; j++) {
+            int row = height - 1 - j;
+            for (int x = 0; x < width; x++)
+                if (row < y0 || row >= y1 || x < x0 || x >= x1)
+                    selected[static_cast<size_t>(j) * width + x] = 0;
+        }
+    }
+
+    accumulation_buffer accum(width, height, accumulation_settings::of(prefs, world));
+    bool                found = false;
+    if (!accum_path.empty() && !accum.load(accum_path, found))
+        return false;
+    if (!accum_path.empty() && !found)
+        std::cerr << std::format("Info: Starting the accumulation file '{}'.\n", accum_path);
+
+    // Rows with something to do; the rest cost nothing.
+    std::vector<int> rows;
+    size_t           pixels = 0;
+    for (int j = 0; j < height; j++) {
+        auto n = std::count(selected.begin() + static_cast<size_t>(j) * width, selected.begin() + static_cast<size_t>(j + 1) * width, 1);
+        if (n > 0)
+            rows.push_back(j);
+        pixels += n;
+    }
+
+    std::cerr << std::format(
+        "Info: Rendering {} of {} pixels ({:.1f}%) with {} samples each.\n",
+        pixels, accum.pixel_count(), 100.0 * pixels / accum.pixel_count(), prefs.samples_per_pixel
+    );
+    auto start = std::chrono::steady_clock::now();
+
+    parallel_for(pool, 0, rows.size(), 1, [&](size_t r) {
+        const int    j    = rows[r];
+        const size_t base = static_cast<size_t>(j) * width;
+
+        auto& scratch = scratch_arena();
+        auto* span    = scratch.allocate_array<pixel_result>(width);
+        auto  smp     = make_sampler(prefs.sampler, prefs.samples_per_pixel, prefs.seed);
+
+        // Runs of selected pixels that continue from the same sample count.
+        for (int x = 0; x < width;) {
+            if (!selected[base + x]) {
+                x++;
+                continue;
+            }
+
+            const uint32_t first = accum.counts[base + x];
+            int            end   = x + 1;
+            while (end < width && selected[base + end] && accum.counts[base + end] == first)
+                end++;
+
+            render_span(prefs, cam, world, x, j, end - x, static_cast<int>(first), prefs.samples_per_pixel, span, *smp);
+            for (int i = x; i < end; i++) {
+                const auto& beauty = span[i - x].beauty;
+                for (int c = 0; c < 3; c++)
+                    accum.sums[3 * (base + i) + c] += beauty[c];
+                accum.counts[base + i] += prefs.samples_per_pixel;
+            }
+            x = end;
+        }
+        scratch.reset();
+    });
+
+    auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cerr << std::format("Info: Finished the region in {}ms.\n", time.count());
+
+    if (!accum_path.empty() && accum.save(accum_path))
+        std::cerr << std::format("Info: Merged into '{}'.\n", accum_path);
+
+    int  samples_per_pixel;
+    auto image = accum.resolve(samples_per_pixel);
+    if (write_file(encode_ppm(image.data(), width, height, samples_per_pixel), output.c_str()))
+        std::cerr << std::format("Info: Saved output to '{}'.\n", output);
+    return true;
+}
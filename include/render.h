@@ -0,0 +1,39 @@
+#pragma once
+#include "camera.h"
+#include "common.h"
+#include "config.h"
+#include "hittable.h"
+#include "kernel.h"
+#include "sampler.h"
+#include "thread_pool.h"
+
+/*
+ * Renders samples [first, first + count) of 'width' pixels of row y starting
+ * at x0 and writes their sums to 'out'. The sampler must come from
+ * make_sampler() with prefs.sampler.
+ */
+inline void render_span(const Prefs& prefs, const camera& cam, const hittable& world, int x0, int y, int width,
+                        int first, int count, pixel_result* out, sampler& smp)
+{
+    select_kernel(prefs, cam)(prefs, cam, world, x0, y, width, first, count, out, smp);
+}
+
+/* Rectangle of pixels [x0, x1) x [y0, y1). */
+struct tile {
+    int x0, y0, x1, y1;
+
+    int width() const  { return x1 - x0; }
+    int height() const { return y1 - y0; }
+    int pixel_count() const { return width() * height(); }
+};
+
+/* Renders a tile on the pool, one row per task. Pixels are stored row by row. */
+inline void render_tile(const Prefs& prefs, const camera& cam, const hittable& world, const tile& t,
+                        pixel_result* pixels, thread_pool* pool)
+{
+    parallel_for(pool, t.y0, t.y1, 1, [&](size_t y) {
+        auto smp = make_sampler(prefs.sampler, prefs.samples_per_pixel, prefs.seed);
+        render_span(prefs, cam, world, t.x0, static_cast<int>(y), t.width(), 0, prefs.samples_per_pixel,
+                    pixels + (y - t.y0) * t.width(), *smp);
+    });
+}
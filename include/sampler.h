@@ -0,0 +1,463 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "common.h"
+
+/*
+ * Samplers hand out the random numbers consumed by one camera sample, one
+ * dimension at a time. The integrator always asks for dimensions in the same
+ * order (pixel jitter, lens, then whatever the hit material's scatter() draws
+ * on each bounce), so low-discrepancy samplers can stratify each of them
+ * across a pixel's samples.
+ */
+
+struct sample2 {
+    double u, v;
+};
+
+enum class sampler_type {
+    independent = 0,
+    stratified  = 1,
+    sobol       = 2,
+    blue_noise  = 3,
+};
+
+inline std::string_view sampler_name(sampler_type type)
+{
+    switch (type) {
+        case sampler_type::independent: return "independent";
+        case sampler_type::stratified:  return "stratified";
+        case sampler_type::sobol:       return "sobol";
+        case sampler_type::blue_noise:  return "blue noise";
+    }
+    return "unknown";
+}
+
+namespace sampling {
+
+// 'lowbias32' integer hash by Chris Wellons.
+inline uint32_t hash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+inline uint32_t hash(uint32_t a, uint32_t b)
+{
+    return hash(a ^ (hash(b) + 0x9e3779b9u + (a << 6) + (a >> 2)));
+}
+
+inline uint32_t hash(uint32_t a, uint32_t b, uint32_t c)
+{
+    return hash(hash(a, b), c);
+}
+
+inline double to_unit(uint32_t x)
+{
+    return x * 0x1p-32;
+}
+
+// O'Neill's PCG32 (XSH RR), one stream per sequence.
+struct pcg32 {
+    uint64_t state = 0;
+    uint64_t inc   = 1;
+
+    void seed(uint64_t initial, uint64_t sequence)
+    {
+        state = 0;
+        inc   = (sequence << 1) | 1;
+        next();
+        state += initial;
+        next();
+    }
+
+    uint32_t next()
+    {
+        uint64_t old        = state;
+        state               = old * 6364136223846793005ull + inc;
+        uint32_t xorshifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+        uint32_t rot        = static_cast<uint32_t>(old >> 59);
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+};
+
+inline uint32_t reverse_bits(uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Hash-based Owen scrambling, from Burley's "Practical Hash-based Owen
+// Scrambling" (JCGT 2020).
+inline uint32_t laine_karras_permutation(uint32_t x, uint32_t seed)
+{
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+inline uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed)
+{
+    return reverse_bits(laine_karras_permutation(reverse_bits(x), seed));
+}
+
+// First two dimensions of the Sobol sequence, which together form a (0,2)-sequence.
+inline uint32_t sobol_dim0(uint32_t i)
+{
+    return reverse_bits(i);
+}
+
+inline uint32_t sobol_dim1(uint32_t i)
+{
+    uint32_t r = 0;
+    for (uint32_t v = 1u << 31; i; i >>= 1, v ^= v >> 1)
+        if (i & 1)
+            r ^= v;
+    return r;
+}
+
+// Kensler's "Correlated Multi-Jittered Sampling" (Pixar 2013).
+inline uint32_t permute(uint32_t i, uint32_t l, uint32_t p)
+{
+    uint32_t w = l - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+
+    do {
+        i ^= p;             i *= 0xe170893du;
+        i ^= p >> 16;
+        i ^= (i & w) >> 4;
+        i ^= p >> 8;        i *= 0x0929eb3fu;
+        i ^= p >> 23;
+        i ^= (i & w) >> 1;  i *= 1 | p >> 27;
+                            i *= 0x6935fa69u;
+        i ^= (i & w) >> 11; i *= 0x74dcb303u;
+        i ^= (i & w) >> 2;  i *= 0x9e501cc3u;
+        i ^= (i & w) >> 2;  i *= 0xc860a3dfu;
+        i &= w;
+        i ^= i >> 5;
+    } while (i >= l);
+
+    return (i + p) % l;
+}
+
+inline double randfloat(uint32_t i, uint32_t p)
+{
+    i ^= p;
+    i ^= i >> 17;
+    i ^= i >> 10;
+    i *= 0xb36534e5u;
+    i ^= i >> 12;
+    i ^= i >> 21;
+    i *= 0x93fc4795u;
+    i ^= 0xdf6e307fu;
+    i ^= i >> 17;
+    i *= 1 | p >> 18;
+    return to_unit(i);
+}
+
+/*
+ * Blue-noise dither mask built once with Ulichney's void-and-cluster method.
+ * Values are ranks normalized to [0, 1) and are used to decorrelate
+ * neighbouring pixels so the remaining error looks like high-frequency noise.
+ */
+constexpr int blue_noise_size = 64;
+
+inline const std::vector<double>& blue_noise_texture()
+{
+    static const std::vector<double> texture = [] {
+        constexpr int    n     = blue_noise_size;
+        constexpr int    count = n * n;
+        constexpr double sigma = 1.5;
+
+        // Toroidal Gaussian energy kernel, indexed by wrapped offset.
+        std::vector<double> kernel(count);
+        for (int dy = 0; dy < n; dy++) {
+            for (int dx = 0; dx < n; dx++) {
+                int    wx = dx < n / 2 ? dx : n - dx;
+                int    wy = dy < n / 2 ? dy : n - dy;
+                kernel[dy * n + dx] = exp(-(wx * wx + wy * wy) / (2 * sigma * sigma));
+            }
+        }
+
+        std::vector<uint8_t> pattern(count, 0);
+        std::vector<double>  energy(count, 0);
+
+        auto splat = [&](std::vector<double>& e, int p, double sign) {
+            int px = p % n, py = p / n;
+            for (int y = 0; y < n; y++)
+                for (int x = 0; x < n; x++)
+                    e[y * n + x] += sign * kernel[((y - py) & (n - 1)) * n + ((x - px) & (n - 1))];
+        };
+
+        auto find = [&](const std::vector<uint8_t>& pat, const std::vector<double>& e, uint8_t value, bool tightest) {
+            int best = -1;
+            for (int i = 0; i < count; i++) {
+                if (pat[i] != value)
+                    continue;
+                if (best < 0 || (tightest ? e[i] > e[best] : e[i] < e[best]))
+                    best = i;
+            }
+            return best;
+        };
+
+        // Initial binary pattern: ~10% of the pixels, then relax until stable.
+        const int initial = count / 10;
+        for (int i = 0; i < initial; i++) {
+            int p = hash(i, 0x5eedu) % count;
+            while (pattern[p])
+                p = (p + 1) % count;
+            pattern[p] = 1;
+            splat(energy, p, 1);
+        }
+
+        while (true) {
+            int cluster = find(pattern, energy, 1, true);
+            pattern[cluster] = 0;
+            splat(energy, cluster, -1);
+
+            int void_ = find(pattern, energy, 0, false);
+            pattern[void_] = 1;
+            splat(energy, void_, 1);
+
+            if (void_ == cluster)
+                break;
+        }
+
+        std::vector<int> rank(count, 0);
+
+        // Phase 1: rank the initial points by removing the tightest clusters.
+        {
+            auto pat = pattern;
+            auto e   = energy;
+            for (int r = initial - 1; r >= 0; r--) {
+                int cluster = find(pat, e, 1, true);
+                pat[cluster] = 0;
+                splat(e, cluster, -1);
+                rank[cluster] = r;
+            }
+        }
+
+        // Phase 2 and 3: fill the largest voids until every pixel is ranked.
+        for (int r = initial; r < count; r++) {
+            int void_ = find(pattern, energy, 0, false);
+            pattern[void_] = 1;
+            splat(energy, void_, 1);
+            rank[void_] = r;
+        }
+
+        std::vector<double> result(count);
+        for (int i = 0; i < count; i++)
+            result[i] = (rank[i] + 0.5) / count;
+        return result;
+    }();
+
+    return texture;
+}
+
+} // namespace sampling
+
+class sampler {
+    public:
+        virtual ~sampler() = default;
+
+        // Must be called before the first dimension of every camera sample.
+        virtual void start_pixel_sample(int x, int y, int sample_index) = 0;
+
+        virtual double  get_1d() = 0;
+        virtual sample2 get_2d() = 0;
+};
+
+/*
+ * Plain uniform random numbers. Every camera sample gets its own stream
+ * seeded from (seed, pixel, sample), so the image doesn't depend on which
+ * thread, tile or machine rendered a pixel.
+ */
+class independent_sampler : public sampler {
+    public:
+        independent_sampler(uint32_t seed) : seed(seed) {}
+
+        virtual void start_pixel_sample(int x, int y, int sample_index) override
+        {
+            rng.seed(sampling::hash(x, y, seed), static_cast<uint32_t>(sample_index));
+        }
+
+        virtual double get_1d() override
+        {
+            return sampling::to_unit(rng.next());
+        }
+
+        virtual sample2 get_2d() override
+        {
+            double u = sampling::to_unit(rng.next());
+            return { u, sampling::to_unit(rng.next()) };
+        }
+
+    private:
+        uint32_t        seed;
+        sampling::pcg32 rng;
+};
+
+/* Latin hypercube samples in 1D and correlated multi-jittered samples in 2D. */
+class stratified_sampler : public sampler {
+    public:
+        stratified_sampler(int samples_per_pixel, uint32_t seed)
+            : spp(samples_per_pixel > 0 ? samples_per_pixel : 1), seed(seed)
+        {
+            m = static_cast<int>(sqrt(static_cast<double>(spp)));
+            n = (spp + m - 1) / m;
+        }
+
+        // Samples past 'spp' start another set of strata with its own scramble.
+        virtual void start_pixel_sample(int x, int y, int sample_index) override
+        {
+            pixel_seed = sampling::hash(x, y, seed + (sample_index / spp) * 0x9e3779b9u);
+            index      = sample_index % spp;
+            dimension  = 0;
+        }
+
+        virtual double get_1d() override
+        {
+            uint32_t p       = sampling::hash(pixel_seed, dimension++);
+            uint32_t stratum = sampling::permute(index, spp, p * 0x68bc21ebu);
+            return (stratum + sampling::randfloat(index, p * 0x02e5be93u)) / spp;
+        }
+
+        virtual sample2 get_2d() override
+        {
+            uint32_t p = sampling::hash(pixel_seed, dimension++);
+            uint32_t s = sampling::permute(index, spp, p * 0x51633e2du);
+
+            uint32_t sx = sampling::permute(s % m, m, p * 0xa511e9b3u);
+            uint32_t sy = sampling::permute(s / m, n, p * 0x63d83595u);
+            double   jx = sampling::randfloat(s, p * 0xa399d265u);
+            double   jy = sampling::randfloat(s, p * 0x711ad6a5u);
+
+            return {
+                (s % m + (sy + jx) / n) / m,
+                (s / m + (sx + jy) / m) / n
+            };
+        }
+
+    private:
+        uint32_t spp, m, n;
+        uint32_t seed;
+        uint32_t pixel_seed = 0;
+        uint32_t index      = 0;
+        uint32_t dimension  = 0;
+};
+
+/*
+ * Owen-scrambled Sobol points. Every dimension (pair) reuses the first two
+ * Sobol dimensions with an independent shuffle and scramble, which keeps the
+ * sequence well distributed at any sample count without direction tables.
+ */
+class sobol_sampler : public sampler {
+    public:
+        sobol_sampler(uint32_t seed) : seed(seed) {}
+
+        virtual void start_pixel_sample(int x, int y, int sample_index) override
+        {
+            pixel_seed = sampling::hash(x, y, seed);
+            index      = sample_index;
+            dimension  = 0;
+        }
+
+        virtual double get_1d() override
+        {
+            uint32_t s = sampling::hash(pixel_seed, dimension++);
+            uint32_t i = sampling::nested_uniform_scramble(index, s);
+            return sampling::to_unit(sampling::nested_uniform_scramble(sampling::sobol_dim0(i), sampling::hash(s, 0)));
+        }
+
+        virtual sample2 get_2d() override
+        {
+            uint32_t s = sampling::hash(pixel_seed, dimension++);
+            uint32_t i = sampling::nested_uniform_scramble(index, s);
+            return {
+                sampling::to_unit(sampling::nested_uniform_scramble(sampling::sobol_dim0(i), sampling::hash(s, 0))),
+                sampling::to_unit(sampling::nested_uniform_scramble(sampling::sobol_dim1(i), sampling::hash(s, 1)))
+            };
+        }
+
+    protected:
+        uint32_t seed;
+        uint32_t pixel_seed = 0;
+        uint32_t index      = 0;
+        uint32_t dimension  = 0;
+};
+
+/*
+ * Every pixel shares one scrambled Sobol sequence, rotated (Cranley-Patterson)
+ * by a per-dimension shifted blue-noise mask. Neighbouring pixels therefore
+ * get well spread offsets and the error shows up as blue noise.
+ */
+class blue_noise_sampler : public sobol_sampler {
+    public:
+        blue_noise_sampler(uint32_t seed)
+            : sobol_sampler(seed), texture(sampling::blue_noise_texture()) {}
+
+        virtual void start_pixel_sample(int x, int y, int sample_index) override
+        {
+            px         = x;
+            py         = y;
+            pixel_seed = seed;
+            index      = sample_index;
+            dimension  = 0;
+        }
+
+        virtual double get_1d() override
+        {
+            uint32_t d = dimension;
+            return rotate(sobol_sampler::get_1d(), d, 0);
+        }
+
+        virtual sample2 get_2d() override
+        {
+            uint32_t d = dimension;
+            auto     s = sobol_sampler::get_2d();
+            return { rotate(s.u, d, 0), rotate(s.v, d, 1) };
+        }
+
+    private:
+        double rotate(double value, uint32_t dim, uint32_t axis) const
+        {
+            constexpr int n = sampling::blue_noise_size;
+
+            uint32_t h = sampling::hash(dim, axis, seed);
+            int      x = (px + static_cast<int>(h & 0xffff)) & (n - 1);
+            int      y = (py + static_cast<int>(h >> 16)) & (n - 1);
+
+            double r = value + texture[y * n + x];
+            return r >= 1.0 ? r - 1.0 : r;
+        }
+
+        const std::vector<double>& texture;
+        int px = 0;
+        int py = 0;
+};
+
+inline std::unique_ptr<sampler> make_sampler(sampler_type type, int samples_per_pixel, uint32_t seed)
+{
+    switch (type) {
+        case sampler_type::stratified: return std::make_unique<stratified_sampler>(samples_per_pixel, seed);
+        case sampler_type::sobol:      return std::make_unique<sobol_sampler>(seed);
+        case sampler_type::blue_noise: return std::make_unique<blue_noise_sampler>(seed);
+        default:                       return std::make_unique<independent_sampler>(seed);
+    }
+}
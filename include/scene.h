@@ -0,0 +1,86 @@
+#pragma once
+#include "arena.h"
+#include "camera.h"
+#include "common.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "moving_sphere.h"
+#include "sphere.h"
+
+/*
+ * The 'Ray Tracing in One Weekend' cover scene. It only depends on the
+ * state of random_double(), so processes seeded the same way build the
+ * same world.
+ */
+inline hittable_list random_scene(arena& mem, bool motion_blur, int extent = 30)
+{
+    hittable_list world;
+    world.reserve(4 + 4 * static_cast<size_t>(extent) * extent);
+
+    auto ground_material = make_arena_shared<lambertian>(mem, color(0.5, 0.5, 0.5));
+    world.add(make_arena_shared<sphere>(mem, point3(0,-1000,0), 1000, ground_material));
+
+    for (int a = -extent; a < extent; a++) {
+        for (int b = -extent; b < extent; b++) {
+            auto choose_mat = random_double();
+            point3 center(
+                a + 0.9*random_double(), 
+                random_double(0.2, 0.5), /* 0.2 */
+                b + 0.9*random_double()
+            );
+
+            if ((center - point3(4, 0.2, 0)).length() > 0.9) {
+                shared_ptr<material> sphere_material;
+
+                if (choose_mat < 0.60) {
+                    // diffuse
+                    auto albedo     = color::random() * color::random();
+                    sphere_material = make_arena_shared<lambertian>(mem, albedo);
+                    if (motion_blur) {
+                        auto center2 = center + vec3(0, random_double(0, 0.5), 0);
+                        world.add(make_arena_shared<moving_sphere>(mem, center, center2, 0.0, 1.0, 0.2, sphere_material));
+                    } else {
+                        world.add(make_arena_shared<sphere>(mem, center, 0.2, sphere_material));
+                    }
+                } else if (choose_mat < 0.75) {
+                    // metal
+                    auto albedo     = color::random(0.5, 1);
+                    auto fuzz       = random_double(0, 0.5);
+                    sphere_material = make_arena_shared<metal>(mem, albedo, fuzz);
+                    world.add(make_arena_shared<sphere>(mem, center, 0.2, sphere_material));
+                } else {
+                    // glass
+                    sphere_material = make_arena_shared<dielectric>(mem, 1.5, 0.0042);
+                    world.add(make_arena_shared<sphere>(mem, center, 0.2, sphere_material));
+                }
+            }
+        }
+    }
+
+    auto material1 = make_arena_shared<dielectric>(mem, 1.5, 0.0042);
+    world.add(make_arena_shared<sphere>(mem, point3(0, 1, 0), 1.0, material1));
+
+    auto material2 = make_arena_shared<lambertian>(mem, color(0.4, 0.2, 0.1));
+    world.add(make_arena_shared<sphere>(mem, point3(-4, 1, 0), 1.0, material2));
+
+    auto material3 = make_arena_shared<metal>(mem, color(0.7, 0.6, 0.5), 0.0);
+    world.add(make_arena_shared<sphere>(mem, point3(4, 1, 0), 1.0, material3));
+
+    return world;
+}
+
+/* The view of the cover scene used for still images and as the start of a turntable. */
+inline camera_params default_camera(double aspect_ratio, double shutter)
+{
+    return {
+        .lookfrom     = point3(13, 2, 3),
+        .lookat       = point3(0, 0, 0),
+        .vup          = vec3(0, 1, 0),
+        .vfov         = 20.0,
+        .aspect_ratio = aspect_ratio,
+        .aperture     = 0.1,
+        .focus_dist   = 10.0,
+        .time0        = 0.0,
+        .time1        = shutter
+    };
+}
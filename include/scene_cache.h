@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "arena.h"
+#include "bvh.h"
+#include "hittable_list.h"
+#include "scene.h"
+#include "thread_pool.h"
+
+/* The inputs random_scene() depends on. Two equal descriptions build the same world. */
+struct scene_desc {
+    int  seed;
+    bool motion_blur;
+};
+
+// FNV-1a over the description, used as the cache key.
+inline uint64_t scene_hash(const scene_desc& desc)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&](const void* data, size_t size) {
+        auto* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ull;
+        }
+    };
+
+    mix(&desc.seed, sizeof(desc.seed));
+    mix(&desc.motion_blur, sizeof(desc.motion_blur));
+    return hash;
+}
+
+/* A built world together with its BVH and the arena that owns its objects. */
+struct cached_scene {
+    arena                mem;
+    hittable_list        world;
+    std::unique_ptr<bvh> accel;
+
+    ~cached_scene()
+    {
+        // The BVH and the list hold references into the arena.
+        accel.reset();
+        world.clear();
+    }
+};
+
+/*
+ * Keeps the most recently used scenes and their BVHs around, so repeated
+ * renders of the same world skip the build. Scenes are handed out as
+ * shared pointers, so evicting one that is still being rendered is safe.
+ */
+class scene_cache {
+    public:
+        explicit scene_cache(size_t capacity) : capacity(std::max<size_t>(capacity, 1)) {}
+
+        std::shared_ptr<cached_scene> get(const scene_desc& desc, thread_pool* pool)
+        {
+            std::unique_lock<std::mutex> lock(cacheMutex);
+
+            const uint64_t key = scene_hash(desc);
+            auto it = entries.find(key);
+            if (it != entries.end()) {
+                order.splice(order.begin(), order, it->second);
+                hit_count++;
+                return it->second->second;
+            }
+
+            // random_scene() draws from the global generator, so builds can't overlap.
+            auto scene = std::make_shared<cached_scene>();
+            seed_random(desc.seed);
+            scene->world = random_scene(scene->mem, desc.motion_blur);
+            scene->accel = std::make_unique<bvh>(scene->world.objects, pool);
+            miss_count++;
+
+            order.emplace_front(key, scene);
+            entries[key] = order.begin();
+            if (order.size() > capacity) {
+                entries.erase(order.back().first);
+                order.pop_back();
+            }
+
+            return scene;
+        }
+
+        size_t hits() const   { return hit_count; }
+        size_t misses() const { return miss_count; }
+
+    private:
+        using entry = std::pair<uint64_t, std::shared_ptr<cached_scene>>;
+
+        size_t                                                   capacity;
+        std::list<entry>                                         order;
+        std::unordered_map<uint64_t, std::list<entry>::iterator> entries;
+        std::mutex                                               cacheMutex;
+        size_t                                                   hit_count  = 0;
+        size_t                                                   miss_count = 0;
+};
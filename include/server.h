@@ -0,0 +1,228 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <format>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "camera.h"
+#include "config.h"
+#include "denoise.h"
+#include "image.h"
+#include "net.h"
+#include "render.h"
+#include "scene_cache.h"
+#include "thread_pool.h"
+
+/*
+ * Long-lived render server. Clients send jobs (settings, camera, output
+ * name) over a local TCP socket; jobs are rendered one after the other on
+ * a single shared thread pool, and the scenes they use stay cached with
+ * their BVHs, so a repeated preview only pays for the pixels.
+ *
+ *   client -> server: render(magic, prefs, camera, output)
+ *   server -> client: reply(ok, milliseconds, cache hit, message)
+ */
+namespace server {
+
+constexpr uint32_t protocol_magic  = 0x31565253; // "SRV1"
+constexpr size_t   max_output_name = 255;
+
+// A render request at its largest, and a generous bound for replies.
+constexpr size_t max_request_size = 2 * sizeof(uint32_t) + sizeof(Prefs) + sizeof(camera_params) + sizeof(uint64_t) + max_output_name;
+constexpr size_t max_reply_size   = 4096;
+
+enum class message : uint32_t {
+    render = 1,
+    reply  = 2,
+};
+
+struct job_result {
+    bool        ok        = false;
+    double      time_ms   = 0;
+    bool        cache_hit = false;
+    std::string message;
+};
+
+struct job {
+    Prefs                    prefs;
+    camera_params            cam;
+    std::string              output;
+    std::promise<job_result> result;
+};
+
+/*
+ * Outputs are written to the server's working directory, so the client may
+ * only pick a plain file name there: no directories, no drive letters.
+ */
+inline bool is_plain_file_name(const std::string& name)
+{
+    return !name.empty() && name.size() <= max_output_name && name != "." && name != ".." &&
+           name.find_first_of("/\\:") == std::string::npos && name.find('\0') == std::string::npos;
+}
+
+/* Renders a job whose settings passed validate(). */
+inline job_result render_job(job& j, scene_cache& scenes, thread_pool& pool)
+{
+    auto& prefs = j.prefs;
+
+    auto start = std::chrono::steady_clock::now();
+
+    size_t misses = scenes.misses();
+    auto   scene  = scenes.get({ prefs.seed, prefs.shutter > 0 }, &pool);
+
+    const size_t count = static_cast<size_t>(prefs.image_width) * prefs.image_height;
+    std::vector<pixel_result> pixels(count);
+    render_tile(prefs, camera(j.cam), *scene->accel, { 0, 0, prefs.image_width, prefs.image_height }, pixels.data(), &pool);
+
+    std::vector<color> beauty(count), albedo(count);
+    std::vector<vec3>  normal(count);
+    for (size_t i = 0; i < count; i++) {
+        beauty[i] = pixels[i].beauty;
+        albedo[i] = pixels[i].albedo;
+        normal[i] = pixels[i].normal;
+    }
+
+    if (prefs.denoise) {
+        denoiser filter(prefs.image_width, prefs.image_height);
+        filter.run(beauty.data(), albedo.data(), normal.data(), prefs.samples_per_pixel, &pool);
+    }
+
+    write_as_ppm(beauty.data(), prefs, (j.output + ".ppm").c_str());
+
+    auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    return {
+        .ok        = true,
+        .time_ms   = time.count() / 1000.0,
+        .cache_hit = scenes.misses() == misses,
+        .message   = j.output + ".ppm"
+    };
+}
+
+/* Serves jobs forever; only returns if the port can't be opened. */
+inline int run_server(const Args& args)
+{
+    auto listener = net::listen(args.port, "127.0.0.1");
+    if (!listener.valid()) {
+        std::cerr << std::format("Error: Couldn't listen on port {}.\n", args.port);
+        return 1;
+    }
+
+    const unsigned threadCount = std::thread::hardware_concurrency();
+    thread_pool    pool(threadCount);
+    scene_cache    scenes(args.cache_size);
+
+    std::mutex              queueMutex;
+    std::condition_variable jobAdded;
+    std::deque<job*>        jobs;
+
+    // Jobs are rendered one at a time so each gets the whole pool.
+    std::thread renderer([&] {
+        while (true) {
+            job* j;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                jobAdded.wait(lock, [&] { return !jobs.empty(); });
+                j = jobs.front();
+                jobs.pop_front();
+            }
+
+            auto result = render_job(*j, scenes, pool);
+            std::cerr << std::format(
+                "Info: Job '{}' took {}ms (scene {}, {} cached hits so far).\n",
+                j->output, result.time_ms, result.cache_hit ? "cached" : "built", scenes.hits()
+            );
+            j->result.set_value(std::move(result));
+        }
+    });
+    renderer.detach();
+
+    // One thread per client; each client can send any number of jobs.
+    auto serve = [&](net::socket s) {
+        std::vector<char> payload;
+        while (s.recv_message(payload, max_request_size)) {
+            net::reader request(payload);
+            uint32_t    kind = 0, magic = 0;
+            job         j;
+            request >> kind >> magic >> j.prefs >> j.cam >> j.output;
+            if (!request.ok() || kind != static_cast<uint32_t>(message::render) || magic != protocol_magic)
+                return;
+
+            if (!validate(j.prefs) || !is_plain_file_name(j.output)) {
+                std::cerr << "Warning: Rejected an invalid job.\n";
+                net::writer reply;
+                reply << static_cast<uint32_t>(message::reply) << false << 0.0 << false << std::string("invalid job");
+                if (!s.send_message(reply.data))
+                    return;
+                continue;
+            }
+
+            auto   done = j.result.get_future();
+            size_t ahead;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                ahead = jobs.size();
+                jobs.push_back(&j);
+            }
+            jobAdded.notify_one();
+            std::cerr << std::format("Info: Queued job '{}' ({} ahead).\n", j.output, ahead);
+
+            auto        result = done.get();
+            net::writer reply;
+            reply << static_cast<uint32_t>(message::reply) << result.ok << result.time_ms << result.cache_hit << result.message;
+            if (!s.send_message(reply.data))
+                return;
+        }
+    };
+
+    std::cerr << std::format("Info: Render server using {} threads, listening on port {}.\n", threadCount, args.port);
+
+    while (true) {
+        auto s = net::accept(listener);
+        if (s.valid())
+            std::thread(serve, std::move(s)).detach();
+    }
+}
+
+/* Sends the local settings as one job and waits for the server to finish it. */
+inline int submit_job(const Args& args, const Prefs& prefs, const camera_params& cam)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    auto s = net::connect(args.host, args.port);
+    if (!s.valid()) {
+        std::cerr << std::format("Error: Couldn't connect to a render server at {}:{}.\n", args.host, args.port);
+        return 1;
+    }
+
+    net::writer request;
+    request << static_cast<uint32_t>(message::render) << protocol_magic << prefs << cam << args.output;
+
+    std::vector<char> payload;
+    uint32_t          kind = 0;
+    job_result        result;
+    if (!s.send_message(request.data) || !s.recv_message(payload, max_reply_size) ||
+        !(net::reader(payload) >> kind >> result.ok >> result.time_ms >> result.cache_hit >> result.message).ok() ||
+        kind != static_cast<uint32_t>(message::reply)) {
+        std::cerr << "Error: The render server didn't answer.\n";
+        return 1;
+    }
+
+    if (!result.ok) {
+        std::cerr << std::format("Error: The render server rejected the job: {}.\n", result.message);
+        return 1;
+    }
+
+    auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    std::cerr << std::format(
+        "Info: Server saved '{}' in {}ms ({} scene), {}ms round trip.\n",
+        result.message, result.time_ms, result.cache_hit ? "cached" : "new", time.count() / 1000.0
+    );
+    return 0;
+}
+
+} // namespace server
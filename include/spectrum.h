@@ -0,0 +1,211 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include "common.h"
+
+/*
+ * Hero-wavelength spectral sampling (Wilkie et al. 2014). Every camera
+ * sample carries four wavelengths spread evenly over the visible range from
+ * one random "hero" wavelength, and the path throughput holds one value per
+ * wavelength. Materials that don't depend on the wavelength treat all four
+ * alike, so a spectral path costs about as much as an RGB one; a dispersive
+ * refraction bends the ray for the hero wavelength only and drops the other
+ * three from the path.
+ *
+ * Scene colors stay RGB. They are turned into smooth spectra with three
+ * overlapping basis functions, chosen so that converting the spectrum back
+ * gives the original color (white stays white).
+ */
+namespace spectral {
+
+constexpr int    sample_count = 4;
+constexpr double lambda_min   = 380;
+constexpr double lambda_max   = 720;
+
+/* One value per sampled wavelength. Plain loops, so they vectorize where the target allows. */
+struct spectrum {
+    double v[sample_count];
+
+    spectrum() : v{ 0, 0, 0, 0 } {}
+    explicit spectrum(double c) : v{ c, c, c, c } {}
+
+    double  operator[](int i) const { return v[i]; }
+    double& operator[](int i)       { return v[i]; }
+
+    spectrum& operator*=(const spectrum& s)
+    {
+        for (int i = 0; i < sample_count; i++)
+            v[i] *= s.v[i];
+        return *this;
+    }
+
+    spectrum operator*(const spectrum& s) const { return spectrum(*this) *= s; }
+};
+
+// Multi-lobe fit of the CIE 1931 color matching functions (Wyman, Sloan & Shirley 2013).
+inline double lobe(double lambda, double mu, double sigma_below, double sigma_above)
+{
+    double t = (lambda - mu) / (lambda < mu ? sigma_below : sigma_above);
+    return std::exp(-0.5 * t * t);
+}
+
+inline color cie_xyz(double lambda)
+{
+    return color(
+        1.056 * lobe(lambda, 599.8, 37.9, 31.0) + 0.362 * lobe(lambda, 442.0, 16.0, 26.7) - 0.065 * lobe(lambda, 501.1, 20.4, 26.2),
+        0.821 * lobe(lambda, 568.8, 46.9, 40.5) + 0.286 * lobe(lambda, 530.9, 16.3, 31.1),
+        1.217 * lobe(lambda, 437.0, 11.8, 36.0) + 0.681 * lobe(lambda, 459.0, 26.0, 13.8)
+    );
+}
+
+inline color xyz_to_linear_srgb(const color& c)
+{
+    return color(
+         3.2404542 * c.x() - 1.5371385 * c.y() - 0.4985314 * c.z(),
+        -0.9692660 * c.x() + 1.8760108 * c.y() + 0.0415560 * c.z(),
+         0.0556434 * c.x() - 0.2040259 * c.y() + 1.0572252 * c.z()
+    );
+}
+
+// Blue, green and red basis functions; they sum to one at every wavelength.
+inline std::array<double, 3> basis(double lambda)
+{
+    auto step = [&](double edge) { return 1 / (1 + std::exp(-(lambda - edge) / 8)); };
+    double blue_green = step(490);
+    double green_red  = step(590);
+    return { 1 - blue_green, blue_green - green_red, green_red };
+}
+
+/*
+ * The curves above tabulated at 1 nm, plus integrals that only depend on
+ * them: the per-channel white balance that maps a constant spectrum to
+ * white, and the matrix turning an RGB color into basis weights.
+ */
+struct tables {
+    static constexpr int size = static_cast<int>(lambda_max - lambda_min) + 1;
+
+    color                 xyz[size];
+    std::array<double, 3> rgb_basis[size];
+    color                 white_balance;
+    double                from_rgb[3][3];
+
+    static const tables& get()
+    {
+        static const tables t = [] {
+            tables result;
+
+            color white(0, 0, 0);
+            color basis_xyz[3];
+            for (int i = 0; i < size; i++) {
+                result.xyz[i]       = cie_xyz(lambda_min + i);
+                result.rgb_basis[i] = basis(lambda_min + i);
+
+                // Trapezoidal rule
+                double weight = i == 0 || i == size - 1 ? 0.5 : 1.0;
+                white += weight * result.xyz[i];
+                for (int k = 0; k < 3; k++)
+                    basis_xyz[k] += weight * result.rgb_basis[i][k] * result.xyz[i];
+            }
+
+            auto white_rgb = xyz_to_linear_srgb(white);
+            result.white_balance = color(1 / white_rgb.x(), 1 / white_rgb.y(), 1 / white_rgb.z());
+
+            // Column k is the color of basis function k; invert to go from colors to weights.
+            double m[3][3];
+            for (int k = 0; k < 3; k++) {
+                auto rgb = result.white_balance * xyz_to_linear_srgb(basis_xyz[k]);
+                for (int c = 0; c < 3; c++)
+                    m[c][k] = rgb[c];
+            }
+
+            double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+                       - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+                       + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+            for (int r = 0; r < 3; r++)
+                for (int c = 0; c < 3; c++)
+                    result.from_rgb[r][c] = (m[(c + 1) % 3][(r + 1) % 3] * m[(c + 2) % 3][(r + 2) % 3]
+                                           - m[(c + 1) % 3][(r + 2) % 3] * m[(c + 2) % 3][(r + 1) % 3]) / det;
+            return result;
+        }();
+
+        return t;
+    }
+
+    // Linear interpolation into the tables.
+    static void lookup(double lambda, int& index, double& frac)
+    {
+        double x = std::clamp(lambda - lambda_min, 0.0, static_cast<double>(size - 1));
+        index    = std::min(static_cast<int>(x), size - 2);
+        frac     = x - index;
+    }
+};
+
+/* The wavelengths of one camera sample and what's needed to evaluate colors at them. */
+struct wavelengths {
+    double lambda[sample_count];
+    double pdf[sample_count];
+    double basis[sample_count][3];
+    color  xyz[sample_count];
+
+    static wavelengths sample(double u)
+    {
+        constexpr double range = lambda_max - lambda_min;
+        const auto&      t     = tables::get();
+
+        wavelengths wl;
+        for (int i = 0; i < sample_count; i++) {
+            double lambda = lambda_min + range * u + i * range / sample_count;
+            wl.lambda[i]  = lambda > lambda_max ? lambda - range : lambda;
+            wl.pdf[i]     = 1 / range;
+
+            int    index;
+            double frac;
+            tables::lookup(wl.lambda[i], index, frac);
+            wl.xyz[i] = (1 - frac) * t.xyz[index] + frac * t.xyz[index + 1];
+            for (int k = 0; k < 3; k++)
+                wl.basis[i][k] = (1 - frac) * t.rgb_basis[index][k] + frac * t.rgb_basis[index + 1][k];
+        }
+        return wl;
+    }
+
+    double hero() const { return lambda[0]; }
+
+    // Keeps only the hero wavelength, which then stands in for all of them.
+    void terminate_secondary()
+    {
+        if (pdf[1] == 0)
+            return;
+        for (int i = 1; i < sample_count; i++)
+            pdf[i] = 0;
+        pdf[0] /= sample_count;
+    }
+
+    // Smooth spectrum of an RGB color at these wavelengths.
+    spectrum from_rgb(const color& c) const
+    {
+        const auto& t = tables::get();
+
+        double weight[3];
+        for (int k = 0; k < 3; k++)
+            weight[k] = t.from_rgb[k][0] * c.x() + t.from_rgb[k][1] * c.y() + t.from_rgb[k][2] * c.z();
+
+        spectrum s;
+        for (int i = 0; i < sample_count; i++)
+            s[i] = std::max(0.0, weight[0] * basis[i][0] + weight[1] * basis[i][1] + weight[2] * basis[i][2]);
+        return s;
+    }
+
+    // Linear RGB estimate of the radiance 's' carried at these wavelengths.
+    color to_rgb(const spectrum& s) const
+    {
+        color sum(0, 0, 0);
+        for (int i = 0; i < sample_count; i++)
+            if (pdf[i] != 0)
+                sum += (s[i] / pdf[i]) * xyz[i];
+
+        return tables::get().white_balance * xyz_to_linear_srgb(sum / sample_count);
+    }
+};
+
+} // namespace spectral
@@ -8,29 +8,35 @@ class sphere : public hittable {
     public:
         sphere() {}
         sphere(point3 cen, double r, shared_ptr<material> m)
-            : center(cen), radius(r), mat_ptr(m) {};
+            : center(cen), radius(r), radius2(r * r), inv_radius(1 / r), mat_ptr(m) {};
 
         virtual bool hit(
             const ray& r,
             double t_min,
             double t_max,
-            hit_record& rec
+            ray_hit& rec
         ) const override;
 
+        virtual void surface(const ray& r, const ray_hit& h, hit_record& rec) const override;
+
+        virtual bool bounding_box(aabb& output_box) const override;
+
     public:
         point3 center;
         double radius;
+        double radius2;
+        double inv_radius;
         shared_ptr<material> mat_ptr;
 };
 
-bool sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) const
+bool sphere::hit(const ray& r, double t_min, double t_max, ray_hit& rec) const
 {
+    // The direction has unit length, so the quadratic needs no division.
     vec3 oc     = r.origin() - center;
-    auto a      = r.direction().length_squared();
     auto half_b = dot(oc, r.direction());
-    auto c      = oc.length_squared() - (radius * radius);
+    auto c      = oc.length_squared() - radius2;
 
-    auto discriminant = (half_b * half_b) - (a * c);
+    auto discriminant = (half_b * half_b) - c;
     if(discriminant < 0) 
         return false;
 
@@ -38,21 +44,35 @@ bool sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) cons
 
     /* find nearest  root that lies within the acceptable range*/
 
-    auto root = (-half_b - sqrtd) / a;
+    auto root = -half_b - sqrtd;
     if(root < t_min || t_max < root) {
-        root = (-half_b + sqrtd) / a;
+        root = -half_b + sqrtd;
         if(root < t_min || t_max < root)
             return false;
     }
 
-    rec.t       = root;
+    rec.t      = root;
+    rec.object = this;
+    return true; 
+}
+
+void sphere::surface(const ray& r, const ray_hit& h, hit_record& rec) const
+{
+    rec.t       = h.t;
     rec.point   = r.at(rec.t);
-    rec.mat_ptr = mat_ptr;
+    rec.mat_ptr = mat_ptr.get();
 
-    vec3 outward_normal = (rec.point - center) / radius;
+    vec3 outward_normal = (rec.point - center) * inv_radius;
     rec.set_face_normal(r, outward_normal);
+}
 
-    return true; 
+bool sphere::bounding_box(aabb& output_box) const
+{
+    output_box = aabb(
+        center - vec3(radius, radius, radius),
+        center + vec3(radius, radius, radius)
+    );
+    return true;
 }
 
 #endif // SPHERE_H
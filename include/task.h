@@ -0,0 +1,163 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "thread_pool.h"
+
+/*
+ * Coroutine tasks on the thread pool, for stages that depend on each other
+ * (building the scene, its acceleration structures, rendering). A task is
+ * started on the pool as soon as it is created. Other tasks co_await it,
+ * which suspends them until the result is there instead of blocking their
+ * thread, and any number of them may await the same task. Outside of
+ * coroutines get() waits, running queued jobs meanwhile. Without a pool a
+ * task runs to completion before its creation returns.
+ *
+ * The pool is the coroutine's first parameter:
+ *
+ *   task<bvh> build_bvh(thread_pool* pool, task<hittable_list>& world);
+ *
+ * The result lives as long as the task object; get() and co_await return a
+ * reference to it.
+ */
+template<typename T>
+class task {
+    public:
+        struct promise_type;
+        using handle = std::coroutine_handle<promise_type>;
+
+        struct promise_type {
+            thread_pool*                         pool = nullptr;
+            std::optional<T>                     value;
+            std::exception_ptr                   error;
+            std::mutex                           waitMutex;
+            std::vector<std::coroutine_handle<>> waiting;
+            bool                                 finished = false;
+            std::atomic<bool>                    done{ false };
+
+            template<typename... Args>
+            promise_type(thread_pool* pool, Args&&...) : pool(pool) {}
+
+            task get_return_object() { return task(handle::from_promise(*this)); }
+
+            auto initial_suspend() noexcept
+            {
+                struct start_on_pool {
+                    thread_pool* pool;
+
+                    bool await_ready() const noexcept { return pool == nullptr; }
+                    void await_suspend(std::coroutine_handle<> h) const { pool->submit([h] { h.resume(); }); }
+                    void await_resume() const noexcept {}
+                };
+                return start_on_pool{ pool };
+            }
+
+            auto final_suspend() noexcept
+            {
+                // Once 'done' is set the task may be destroyed from another
+                // thread, so nothing of the frame is touched after that.
+                struct wake_waiting {
+                    bool await_ready() const noexcept { return false; }
+
+                    void await_suspend(handle h) const noexcept
+                    {
+                        auto&                                promise = h.promise();
+                        thread_pool*                         pool    = promise.pool;
+                        std::vector<std::coroutine_handle<>> waiting;
+                        {
+                            std::unique_lock<std::mutex> lock(promise.waitMutex);
+                            promise.finished = true;
+                            waiting.swap(promise.waiting);
+                        }
+                        promise.done.store(true, std::memory_order_release);
+
+                        for (auto w : waiting) {
+                            if (pool)
+                                pool->submit([w] { w.resume(); });
+                            else
+                                w.resume();
+                        }
+                    }
+
+                    void await_resume() const noexcept {}
+                };
+                return wake_waiting{};
+            }
+
+            template<typename V>
+            void return_value(V&& v) { value.emplace(std::forward<V>(v)); }
+
+            void unhandled_exception() { error = std::current_exception(); }
+        };
+
+        task(task&& other) noexcept : coroutine(std::exchange(other.coroutine, {})) {}
+        task(const task&) = delete;
+        task& operator=(const task&) = delete;
+        task& operator=(task&&) = delete;
+
+        ~task()
+        {
+            if (!coroutine)
+                return;
+            wait();
+            coroutine.destroy();
+        }
+
+        bool done() const { return coroutine.promise().done.load(std::memory_order_acquire); }
+
+        // Waits for the result, running the pool's queued jobs meanwhile.
+        T& get()
+        {
+            wait();
+            return result();
+        }
+
+        auto operator co_await()
+        {
+            struct awaiter {
+                task& t;
+
+                bool await_ready() const { return t.done(); }
+
+                bool await_suspend(std::coroutine_handle<> h) const
+                {
+                    auto&                        promise = t.coroutine.promise();
+                    std::unique_lock<std::mutex> lock(promise.waitMutex);
+                    if (promise.finished)
+                        return false;
+                    promise.waiting.push_back(h);
+                    return true;
+                }
+
+                T& await_resume() const { return t.result(); }
+            };
+            return awaiter{ *this };
+        }
+
+    private:
+        explicit task(handle h) : coroutine(h) {}
+
+        void wait() const
+        {
+            auto* pool = coroutine.promise().pool;
+            while (!done()) {
+                if (!pool || !pool->run_pending())
+                    std::this_thread::yield();
+            }
+        }
+
+        T& result()
+        {
+            auto& promise = coroutine.promise();
+            if (promise.error)
+                std::rethrow_exception(promise.error);
+            return *promise.value;
+        }
+
+        handle coroutine;
+};
@@ -0,0 +1,204 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed set of worker threads shared by the scene build and the render.
+ * Threads that wait on a task_group keep executing queued jobs, so tasks
+ * can spawn and wait for sub-tasks without deadlocking the pool.
+ *
+ * Every worker has its own job queue. Jobs submitted by a worker go to its
+ * queue and are taken newest first, which keeps a task's sub-tasks on the
+ * thread whose caches hold their data; a worker that runs out steals the
+ * oldest job of another one. Jobs from other threads go to a shared queue.
+ */
+class thread_pool {
+    public:
+        explicit thread_pool(unsigned thread_count)
+        {
+            thread_count = std::max(thread_count, 1u);
+            for (unsigned i = 0; i <= thread_count; i++)
+                queues.push_back(std::make_unique<job_queue>());
+            for (unsigned i = 0; i < thread_count; i++)
+                workers.emplace_back([this, i] { worker_loop(i); });
+        }
+
+        ~thread_pool()
+        {
+            {
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                stopping = true;
+            }
+            jobsReady.notify_all();
+
+            for (auto& worker : workers)
+                worker.join();
+        }
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+        void submit(std::function<void()> job)
+        {
+            auto& queue = *queues[current_worker() == no_worker ? shared_queue() : current_worker()];
+            queued++;
+            {
+                std::unique_lock<std::mutex> lock(queue.jobsMutex);
+                queue.jobs.push_back(std::move(job));
+            }
+
+            // Taking the lock orders this against a worker about to sleep.
+            { std::unique_lock<std::mutex> lock(sleepMutex); }
+            jobsReady.notify_one();
+        }
+
+        // Runs one queued job on the calling thread, if there is any.
+        bool run_pending()
+        {
+            std::function<void()> job;
+            if (!take(current_worker(), job))
+                return false;
+
+            job();
+            return true;
+        }
+
+    private:
+        static constexpr unsigned no_worker = ~0u;
+
+        struct job_queue {
+            std::mutex                        jobsMutex;
+            std::deque<std::function<void()>> jobs;
+        };
+
+        unsigned shared_queue() const { return size(); }
+
+        // Index of the calling thread among this pool's workers.
+        unsigned current_worker() const { return worker_pool == this ? worker_index : no_worker; }
+
+        bool pop(unsigned index, bool newest, std::function<void()>& job)
+        {
+            auto&                        queue = *queues[index];
+            std::unique_lock<std::mutex> lock(queue.jobsMutex);
+            if (queue.jobs.empty())
+                return false;
+
+            if (newest) {
+                job = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+            } else {
+                job = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+            }
+            queued--;
+            return true;
+        }
+
+        // Own queue first, then the shared one, then the other workers'.
+        bool take(unsigned self, std::function<void()>& job)
+        {
+            if (queued == 0)
+                return false;
+            if (self != no_worker && pop(self, true, job))
+                return true;
+            if (pop(shared_queue(), false, job))
+                return true;
+
+            const unsigned start = self == no_worker ? 0 : self + 1;
+            for (unsigned i = 0; i < size(); i++) {
+                unsigned victim = (start + i) % size();
+                if (victim != self && pop(victim, false, job))
+                    return true;
+            }
+            return false;
+        }
+
+        void worker_loop(unsigned index)
+        {
+            worker_pool  = this;
+            worker_index = index;
+
+            while (true) {
+                std::function<void()> job;
+                if (take(index, job)) {
+                    job();
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                jobsReady.wait(lock, [this] { return stopping || queued > 0; });
+                if (stopping && queued == 0)
+                    return;
+            }
+        }
+
+        static inline thread_local const thread_pool* worker_pool  = nullptr;
+        static inline thread_local unsigned           worker_index = no_worker;
+
+        std::vector<std::thread>                workers;
+        std::vector<std::unique_ptr<job_queue>> queues; // one per worker, then the shared one
+        std::atomic<size_t>                     queued{ 0 };
+        std::mutex                              sleepMutex;
+        std::condition_variable                 jobsReady;
+        bool                                    stopping = false;
+};
+
+/* Set of jobs that can be waited on together. Without a pool, jobs run inline. */
+class task_group {
+    public:
+        explicit task_group(thread_pool* pool) : pool(pool) {}
+        ~task_group() { wait(); }
+
+        template<typename F>
+        void run(F&& job)
+        {
+            if (!pool) {
+                job();
+                return;
+            }
+
+            pending++;
+            pool->submit([this, job = std::forward<F>(job)]() mutable {
+                job();
+                pending--;
+            });
+        }
+
+        bool done() const { return pending == 0; }
+
+        void wait()
+        {
+            while (pending > 0) {
+                if (!pool->run_pending())
+                    std::this_thread::yield();
+            }
+        }
+
+    private:
+        thread_pool*     pool;
+        std::atomic<int> pending{ 0 };
+};
+
+/* Calls body(i) for every i in [begin, end), split into chunks of 'grain'. */
+template<typename F>
+void parallel_for(thread_pool* pool, size_t begin, size_t end, size_t grain, F&& body)
+{
+    task_group group(pool);
+    for (size_t first = begin; first < end; first += grain) {
+        size_t last = std::min(first + grain, end);
+        group.run([&body, first, last] {
+            for (size_t i = first; i < last; i++)
+                body(i);
+        });
+    }
+    group.wait();
+}
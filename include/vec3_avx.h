@@ -196,21 +196,50 @@ inline vec3 unit_vector(vec3 v)
 	return res;
 }
 
-inline vec3 random_in_unit_sphere()
+// Closed-form mappings from uniform samples in [0, 1) to the usual domains.
+// They replace the old rejection loops, so every call consumes a fixed
+// number of sample dimensions and never loops.
+inline vec3 sample_unit_disk(double u1, double u2)
 {
-	while (true) {
-		auto p = vec3::random(-1, 1);
-		if (p.length_squared() >= 1)
-			continue;
-		return p;
+	// Shirley-Chiu concentric mapping
+	auto a = 2 * u1 - 1;
+	auto b = 2 * u2 - 1;
+	if (a == 0 && b == 0)
+		return vec3(0, 0, 0);
+
+	double r, phi;
+	if (fabs(a) > fabs(b)) {
+		r   = a;
+		phi = (pi / 4) * (b / a);
+	} else {
+		r   = b;
+		phi = (pi / 2) - (pi / 4) * (a / b);
 	}
+
+	return vec3(r * cos(phi), r * sin(phi), 0);
+}
+
+inline vec3 sample_unit_vector(double u1, double u2)
+{
+	auto z   = 1 - 2 * u1;
+	auto r   = sqrt(fmax(0.0, 1 - z * z));
+	auto phi = 2 * pi * u2;
+	return vec3(r * cos(phi), r * sin(phi), z);
+}
+
+inline vec3 sample_unit_sphere(double u1, double u2, double u3)
+{
+	return cbrt(u3) * sample_unit_vector(u1, u2);
+}
+
+inline vec3 random_in_unit_sphere()
+{
+	return sample_unit_sphere(random_double(), random_double(), random_double());
 }
 
 inline vec3 random_unit_vector()
 {
-	return unit_vector(
-		random_in_unit_sphere()
-	);
+	return sample_unit_vector(random_double(), random_double());
 }
 
 inline vec3 random_in_hemisphere(const vec3& normal)
@@ -223,18 +252,7 @@ inline vec3 random_in_hemisphere(const vec3& normal)
 
 inline vec3 random_in_unit_disk()
 {
-	while (true) {
-		auto p = vec3(
-			random_double(-1, 1),
-			random_double(-1, 1),
-			0
-		);
-
-		if (p.length_squared() >= 1)
-			continue;
-
-		return p;
-	}
+	return sample_unit_disk(random_double(), random_double());
 }
 
 inline vec3 reflect(const vec3& v, const vec3& n)
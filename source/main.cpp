@@ -1,12 +1,29 @@
+#include "animation.h"
+#include "arena.h"
+#include "batch.h"
+#include "bvh.h"
 #include "common.h"
 #include "hittable.h"
 #include "hittable_list.h"
-#include "material.h"
-#include "sphere.h"
 #include "camera.h"
 #include "config.h"
+#include "denoise.h"
+#include "distributed.h"
+#include "grid.h"
 #include "image.h"
-
+#include "out_of_core.h"
+#include "output_writer.h"
+#include "perf_check.h"
+#include "preview.h"
+#include "region.h"
+#include "render.h"
+#include "sampler.h"
+#include "scene.h"
+#include "server.h"
+#include "task.h"
+#include "thread_pool.h"
+
+#include <algorithm>
 #include <format>
 #include <chrono>
 #include <queue>
@@ -14,130 +31,262 @@
 #include <mutex>
 #include <vector>
 
-struct point2 {
-    int x, y;
-};
-
 static Prefs prefs;
 static color* pBuffer = NULL;
+static color* pAlbedo = NULL;
+static vec3*  pNormal = NULL;
 color& pixelAt(size_t x, size_t y)
 {
     return pBuffer[y * prefs.image_width + x];
 }
 
-color ray_color(const ray& r, const hittable& world, int depth)
+static std::queue<int> lineQueue;
+static std::mutex      queueMutex;
+void WorkerThread(const camera& cam, const hittable& world)
 {
-    hit_record rec;
+    auto smp = make_sampler(prefs.sampler, prefs.samples_per_pixel, prefs.seed);
 
-    // If we've exceeded the ray bounce limit, no more light is gathered.
-    if (depth <= 0)
-        return color(0,0,0);
+    while(true) {
+        int line;
 
-    if (world.hit(r, 0.001, infinity, rec)) {
-        ray   scattered;
-        color attenuation;
+        // By adding a new scope the mutex lock gets destroyed
+        // early so another thread can read from the queue faster.
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            if(lineQueue.empty())
+                return;
+            line = lineQueue.front();
+            lineQueue.pop();
+        }
 
-        if (rec.mat_ptr->scatter(r, rec, attenuation, scattered))
-            return attenuation * ray_color(scattered, world, depth-1);
+        // Accumulate the line in scratch memory and publish it in one go.
+        auto& scratch = scratch_arena();
+        auto* pixels  = scratch.allocate_array<pixel_result>(prefs.image_width);
 
-        return color(0,0,0);
-    }
+        render_span(prefs, cam, world, 0, line, prefs.image_width, 0, prefs.samples_per_pixel, pixels, *smp);
 
-    vec3 unit_direction = unit_vector(r.direction());
-    auto t              = 0.5*(unit_direction.y() + 1.0);
-    return (1.0-t)*color(1.0, 1.0, 1.0) + t*color(0.5, 0.7, 1.0);
+        for(int i = 0; i < prefs.image_width; i++) {
+            pixelAt(i, line) = pixels[i].beauty;
+            pAlbedo[line * prefs.image_width + i] = pixels[i].albedo;
+            pNormal[line * prefs.image_width + i] = pixels[i].normal;
+        }
+        scratch.reset();
+    }
 }
 
-hittable_list random_scene()
+// Renders one frame into pBuffer, using the pool's threads if there is one.
+void render_frame(const camera& cam, const hittable& world, thread_pool* pool)
 {
-    hittable_list world;
-
-    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-    world.add(make_shared<sphere>(point3(0,-1000,0), 1000, ground_material));
-
-    for (int a = -30; a < 30; a++) {
-        for (int b = -30; b < 30; b++) {
-            auto choose_mat = random_double();
-            point3 center(
-                a + 0.9*random_double(), 
-                random_double(0.2, 0.5), /* 0.2 */
-                b + 0.9*random_double()
-            );
-
-            if ((center - point3(4, 0.2, 0)).length() > 0.9) {
-                shared_ptr<material> sphere_material;
-
-                if (choose_mat < 0.60) {
-                    // diffuse
-                    auto albedo     = color::random() * color::random();
-                    sphere_material = make_shared<lambertian>(albedo);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                } else if (choose_mat < 0.75) {
-                    // metal
-                    auto albedo     = color::random(0.5, 1);
-                    auto fuzz       = random_double(0, 0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                } else {
-                    // glass
-                    sphere_material = make_shared<dielectric>(1.5);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
+    auto start = std::chrono::system_clock::now();
+
+    if (pool) {
+        for(int j = prefs.image_height - 1; j >= 0; --j) {
+            lineQueue.push(j);
+        }
+
+        std::cerr << std::format("Info: Using {} threads.\n", pool->size());
+
+        task_group workers(pool);
+        for(unsigned i = 0; i < pool->size(); i++) {
+            workers.run([&] { WorkerThread(cam, world); });
+        }
+
+        while(!workers.done()) {
+            size_t remaining;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                remaining = lineQueue.size();
             }
+
+            std::cerr << std::format("\rScanlines remaining: {} ", remaining);
+            std::cerr << std::flush;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
         }
-    }
 
-    auto material1 = make_shared<dielectric>(1.5);
-    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
+        workers.wait();
+    } else {
+        std::cerr << "Info: Using one single thread.\n";
 
-    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
-    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
+        auto smp    = make_sampler(prefs.sampler, prefs.samples_per_pixel, prefs.seed);
+        auto pixels = std::vector<pixel_result>(prefs.image_width);
+        for(int j = prefs.image_height - 1; j >= 0; --j) {
+            render_span(prefs, cam, world, 0, j, prefs.image_width, 0, prefs.samples_per_pixel, pixels.data(), *smp);
+            for(int i = 0; i < prefs.image_width; ++i) {
+                pixelAt(i, j) = pixels[i].beauty;
+                pAlbedo[j * prefs.image_width + i] = pixels[i].albedo;
+                pNormal[j * prefs.image_width + i] = pixels[i].normal;
+            }
 
-    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
-    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
+            std::cerr << std::format("\rScanlines remaining: {} ", j);
+            std::cerr << std::flush;
+        }
+    }
 
-    return world;
+    auto end  = std::chrono::system_clock::now();
+    auto time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+    std::cerr << std::format(
+        "\nInfo: Finished rendering in {}ms/{}s/{}m.\n",
+        time.count(),
+        time.count() / 1000,
+        time.count() / 1000 / 60
+    );
 }
 
-static std::queue<int> lineQueue;
-static std::mutex      queueMutex;
-static std::mutex      flagMutex;
-static unsigned        threadsFinished = 0;
-void WorkerThread(camera& cam, hittable& world)
+// Renders one frame in passes of one sample per pixel until the next pass
+// would run past 'budget' seconds, or prefs.samples_per_pixel passes are
+// done. At least one pass is always taken. Returns the number of passes,
+// which is the sample count the buffers hold.
+int render_budgeted(const camera& cam, const hittable& world, thread_pool* pool, double budget)
 {
-    while(true) {
-        int line;
+    using clock = std::chrono::steady_clock;
+
+    const size_t count    = static_cast<size_t>(prefs.image_width) * prefs.image_height;
+    const auto   start    = clock::now();
+    const auto   deadline = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(budget));
+    std::fill(pBuffer, pBuffer + count, color(0, 0, 0));
+    std::fill(pAlbedo, pAlbedo + count, color(0, 0, 0));
+    std::fill(pNormal, pNormal + count, vec3(0, 0, 0));
+
+    int  passes   = 0;
+    auto lastPass = clock::duration::zero();
+    while (passes < prefs.samples_per_pixel && (passes == 0 || clock::now() + lastPass <= deadline)) {
+        auto passStart = clock::now();
+
+        parallel_for(pool, 0, prefs.image_height, 1, [&](size_t y) {
+            auto& scratch = scratch_arena();
+            auto* pixels  = scratch.allocate_array<pixel_result>(prefs.image_width);
+            auto  smp     = make_sampler(prefs.sampler, prefs.samples_per_pixel, prefs.seed);
+            render_span(prefs, cam, world, 0, static_cast<int>(y), prefs.image_width, passes, 1, pixels, *smp);
+
+            const size_t row = y * prefs.image_width;
+            for (int i = 0; i < prefs.image_width; i++) {
+                pBuffer[row + i] += pixels[i].beauty;
+                pAlbedo[row + i] += pixels[i].albedo;
+                pNormal[row + i] += pixels[i].normal;
+            }
+            scratch.reset();
+        });
 
-        // By adding a new scope the mutex lock gets destroyed
-        // early so another thread can read from the queue faster.
-        {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            if(lineQueue.empty()) {
-                std::unique_lock<std::mutex> flagLock(flagMutex);
-                threadsFinished++;
-                return;
+        passes++;
+        lastPass = clock::now() - passStart;
+        std::cerr << std::format("\rPass {} ({}ms) ", passes, std::chrono::duration_cast<std::chrono::milliseconds>(lastPass).count());
+        std::cerr << std::flush;
+    }
+
+    auto time = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start);
+    std::cerr << std::format(
+        "\nInfo: Took {} samples per pixel in {}ms of a {}ms budget.\n",
+        passes,
+        time.count(),
+        static_cast<long long>(budget * 1000)
+    );
+    return passes;
+}
+
+// Renders one frame by handing its tiles to worker processes.
+void render_distributed(const camera_params& cam, const Args& args)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    distributed::run_coordinator(prefs, cam, args, [](const tile& t, const pixel_result* pixels) {
+        for (int y = t.y0; y < t.y1; y++) {
+            for (int x = t.x0; x < t.x1; x++) {
+                const auto& p = pixels[(y - t.y0) * t.width() + (x - t.x0)];
+                pixelAt(x, y) = p.beauty;
+                pAlbedo[y * prefs.image_width + x] = p.albedo;
+                pNormal[y * prefs.image_width + x] = p.normal;
             }
-            line = lineQueue.front();
-            lineQueue.pop();
         }
+    });
 
-        for(int i = 0; i < prefs.image_width; i++) {
-            point2 pixel = { 
-                .x = i,
-                .y = line
-            };
-
-            color pixel_color(0,0,0);
-            for (int s = 0; s < prefs.samples_per_pixel; ++s) {
-                auto u = (pixel.x + random_double()) / (prefs.image_width  - 1);
-                auto v = (pixel.y + random_double()) / (prefs.image_height - 1);
-                ray  r = cam.get_ray(u, v);
-                pixel_color += ray_color(r, world, prefs.max_depth);
-            }
+    auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cerr << std::format("Info: Finished distributed rendering in {}ms.\n", time.count());
+}
 
-            pixelAt(pixel.x, pixel.y) = pixel_color;
-        }
+// Writes the frame to '<base>.ppm'. With denoising enabled, the AOVs are
+// saved next to it and the beauty buffer is filtered before writing. The
+// buffers are copied into the writer's queue and saved in the background.
+void write_frame(const std::string& base, thread_pool* pool, output_writer& writer)
+{
+    const size_t count = static_cast<size_t>(prefs.image_width) * prefs.image_height;
+    std::cerr << std::format("Info: Image hash {:016x}.\n", image_hash(pBuffer, count));
+
+    if (prefs.denoise) {
+        // Map normals from [-1, 1] to [0, 1] so they can be viewed as colors.
+        std::vector<color> normals(count);
+        for (size_t i = 0; i < count; i++)
+            normals[i] = 0.5 * (pNormal[i] + vec3(1, 1, 1) * prefs.samples_per_pixel);
+
+        writer.write_ppm(pAlbedo, prefs, base + "_albedo.ppm");
+        writer.write_ppm(std::move(normals), prefs, base + "_normal.ppm");
+
+        auto start = std::chrono::steady_clock::now();
+        denoiser filter(prefs.image_width, prefs.image_height);
+        filter.run(pBuffer, pAlbedo, pNormal, prefs.samples_per_pixel, pool);
+        auto time  = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        std::cerr << std::format("Info: Denoised frame in {}ms.\n", time.count() / 1000.0);
     }
+
+    writer.write_ppm(pBuffer, prefs, base + ".ppm");
+}
+
+/*
+ * Scene setup stages. The BVH and the grid only depend on the world, so
+ * they are built at the same time, and the render waits only for the one it
+ * traces with while the other one finishes in the background. Every stage
+ * takes its pool as the first parameter, which is where task.h finds it,
+ * even if the body itself doesn't use it.
+ */
+task<hittable_list> build_world([[maybe_unused]] thread_pool* pool, arena& mem, bool motion_blur, bool streamed)
+{
+    // A streamed scene replaces the built one.
+    if (streamed)
+        co_return hittable_list();
+
+    auto world = random_scene(mem, motion_blur);
+    std::cerr << std::format("Info: Scene uses {} KiB of arena memory.\n", mem.bytes_used() / 1024);
+    co_return world;
+}
+
+task<std::unique_ptr<bvh>> build_bvh(thread_pool* pool, task<hittable_list>& world)
+{
+    const auto& objects = (co_await world).objects;
+
+    auto buildStart = std::chrono::steady_clock::now();
+    auto accel      = std::make_unique<bvh>(objects, pool);
+    auto buildTime  = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - buildStart);
+    std::cerr << std::format(
+        "Info: Built BVH over {} primitives ({} nodes) in {}ms.\n",
+        accel->primitive_count(),
+        accel->node_count(),
+        buildTime.count() / 1000.0
+    );
+    co_return accel;
+}
+
+// Null if the BVH is used instead.
+task<std::unique_ptr<uniform_grid>> build_grid([[maybe_unused]] thread_pool* pool, task<hittable_list>& world, accel_type type)
+{
+    if (type == accel_type::bvh)
+        co_return nullptr;
+
+    const auto& objects = (co_await world).objects;
+
+    auto gridStart = std::chrono::steady_clock::now();
+    auto grid      = std::make_unique<uniform_grid>(objects);
+    auto gridTime  = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - gridStart);
+    std::cerr << std::format(
+        "Info: Built {}x{}x{} grid ({} large primitives, {:.0f}% of cells occupied) in {}ms.\n",
+        grid->resolution(0), grid->resolution(1), grid->resolution(2),
+        grid->large_count(),
+        100 * grid->occupancy(),
+        gridTime.count() / 1000.0
+    );
+
+    if (type == accel_type::automatic && !grid->suits_scene())
+        grid.reset();
+    std::cerr << std::format("Info: Tracing with the {}.\n", grid ? "grid" : "BVH");
+    co_return grid;
 }
 
 // These two need to be static so that 'generator' can be constructed
@@ -149,10 +298,41 @@ double random_double()
     return distribution(generator);
 }
 
-int main() {
+void seed_random(unsigned seed)
+{
+    generator = std::mt19937(seed);
+}
+
+int main(int argc, char** argv) {
+    Args args = parse_args(argc, argv);
+    if (args.mode == run_mode::usage) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // Workers get all their settings from the coordinator.
+    if (args.mode == run_mode::worker)
+        return distributed::run_worker(args);
+    if (args.mode == run_mode::server)
+        return server::run_server(args);
+
+    // Uses fixed settings so results stay comparable.
+    if (args.mode == run_mode::perf_check)
+        return perf::run(args.perf_runs, args.perf_update, args.perf_refs);
+
     // Read config from file
     prefs = read_from_file("prefs.cfg");
 
+    if (args.mode == run_mode::submit)
+        return server::submit_job(args, prefs, default_camera(prefs.aspect_ratio, prefs.shutter));
+
+    if (args.mode == run_mode::write_scene) {
+        seed_random(prefs.seed);
+        arena mem;
+        auto  world = random_scene(mem, false, args.scene_extent);
+        return scene_file::write(args.write_scene_path, world) ? 0 : 1;
+    }
+
 #ifndef NDEBUG
     std::cerr << "SoftwareRT (Debug Build)\n";
 #else
@@ -167,102 +347,68 @@ int main() {
     std::cerr << std::format(" | Max depth: {}\n", prefs.max_depth);
     std::cerr << std::format(" | Enable multithreading: {}\n", prefs.use_threading);
     std::cerr << std::format(" | World seed: {}\n", prefs.seed);
+    std::cerr << std::format(" | Sampler: {}\n", sampler_name(prefs.sampler));
+    std::cerr << std::format(" | Frames: {}\n", prefs.frames);
+    std::cerr << std::format(" | Shutter: {}\n", prefs.shutter);
+    std::cerr << std::format(" | Denoise: {}\n", prefs.denoise);
+    std::cerr << std::format(" | Spectral: {}\n", prefs.spectral);
 
-    generator = std::mt19937(prefs.seed);
+    seed_random(prefs.seed);
     pBuffer = new color[prefs.image_width * prefs.image_height];
+    pAlbedo = new color[prefs.image_width * prefs.image_height];
+    pNormal = new vec3[prefs.image_width * prefs.image_height];
 
-    // World
+    // Threads are shared by the scene build and the render
 
-    auto world = random_scene();
+    const unsigned threadCount = prefs.use_threading ? std::thread::hardware_concurrency() : 1;
+    std::unique_ptr<thread_pool> pool;
+    if (prefs.use_threading)
+        pool = std::make_unique<thread_pool>(threadCount);
 
-    // Camera
-
-    point3 lookfrom(13,2,3);
-    point3 lookat(0,0,0);
-    vec3   vup(0,1,0);
-    auto   dist_to_focus = 10.0;
-    auto   aperture      = 0.1;
-
-    camera cam(
-        lookfrom, 
-        lookat,
-        vup,
-        20,
-        prefs.aspect_ratio,
-        aperture,
-        dist_to_focus
-    );
-
-    // Render
-
-    auto start = std::chrono::system_clock::now();
-
-    if (prefs.use_threading) {
-        for(int j = prefs.image_height - 1; j >= 0; --j) {
-            lineQueue.push(j);
-        }
+    // World
 
-        const unsigned threadCount = std::thread::hardware_concurrency();
-        std::cerr << std::format("Info: Using {} threads.\n", threadCount);
+    // A scene file is streamed from disk and replaces the built scene.
+    std::unique_ptr<out_of_core_scene> streamed;
+    if (!args.scene_path.empty()) {
+        streamed = std::make_unique<out_of_core_scene>(args.scene_path, static_cast<size_t>(args.resident_mb) << 20);
+        if (!streamed->valid())
+            return 1;
+        if (args.mode == run_mode::coordinator)
+            std::cerr << "Warning: Workers build their own scene, the scene file is only used locally.\n";
+    }
 
-        std::vector<std::thread> threads(0);
-        for(unsigned i = 0; i < threadCount; i++) {
-            threads.push_back(
-                std::thread(WorkerThread, std::ref(cam), std::ref(world))
-            );
-        }
+    arena sceneArena;
+    auto  worldTask = build_world(pool.get(), sceneArena, prefs.shutter > 0, streamed != nullptr);
+    auto  accelTask = build_bvh(pool.get(), worldTask);
+    auto  gridTask  = build_grid(pool.get(), worldTask, streamed ? accel_type::bvh : args.accel);
 
-        while(true) {
-            std::unique_lock<std::mutex> flagLock(flagMutex);
-            if(threadsFinished == threadCount) {
-                break;
-            }
+    auto& world = worldTask.get();
+    auto& grid  = gridTask.get();
 
-            std::cerr << std::format("\rScanlines remaining: {} ", lineQueue.size());
-            std::cerr << std::flush;
-        }
+    const hittable& root = streamed ? static_cast<const hittable&>(*streamed)
+                         : grid     ? static_cast<const hittable&>(*grid)
+                                    : *accelTask.get();
 
-        for(auto& thread : threads)
-            thread.join();
+    // Camera
 
-        threads.clear();
-    } else {
-        std::cerr << "Info: Using one single thread.\n";
+    camera_params view = default_camera(prefs.aspect_ratio, prefs.shutter);
 
-        for(int j = prefs.image_height - 1; j >= 0; --j) {
-            for(int i = 0; i < prefs.image_width; ++i) {
-                color pixel_color(0, 0, 0);
-                for(int s = 0; s < prefs.samples_per_pixel; ++s) {
-                    auto u   = (i + random_double()) / (prefs.image_width  - 1);
-                    auto v   = (j + random_double()) / (prefs.image_height - 1);
-                    ray  ray = cam.get_ray(u, v);
-                    pixel_color += ray_color(ray, world, prefs.max_depth);
-                }
-
-                pixelAt(i, j) = pixel_color;
-            }
+    if (args.mode == run_mode::preview || args.mode == run_mode::batch) {
+        if (args.mode == run_mode::preview)
+            run_preview(prefs, root, view, pool.get(), args.preview_path);
+        else
+            render_batch(prefs, root, view, pool.get(), args.views_path);
 
-            std::cerr << std::format("\rScanlines remaining: {} ", j);
-            std::cerr << std::flush;
-        }
+        delete[] pBuffer;
+        delete[] pAlbedo;
+        delete[] pNormal;
+        return 0;
     }
 
-
-    auto end  = std::chrono::system_clock::now();
-    auto time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-    std::cerr << std::format(
-        "\nInfo: Finished rendering in {}ms/{}s/{}m.\n",
-        time.count(),
-        time.count() / 1000,
-        time.count() / 1000 / 60
-    );
-
-    std::cerr << "Info: Writing output to file.\n";
-
+    // Filename: MM-DD HH:MM:SS
     const std::time_t now = std::time(nullptr);
     const std::tm calendarTime = *std::localtime(std::addressof(now));
 
-    // Filename: MM-DD HH:MM:SS
     std::string out = std::format(
         "{}-{} {}-{}-{}", 
         calendarTime.tm_mon,
@@ -272,12 +418,91 @@ int main() {
         calendarTime.tm_sec
     );
 
-    std::string out_ppm = out + ".ppm";
-    std::string out_bmp = out + ".bmp";
+    // Partial renders merge into an accumulation file, one frame at a time.
+    if (!args.accum_path.empty() || !args.crop.empty() || !args.mask_path.empty()) {
+        if (prefs.frames > 1 || args.mode == run_mode::coordinator)
+            std::cerr << "Warning: Region renders cover the first frame only and are rendered locally.\n";
+
+        bool done = render_region(prefs, camera(view), root, pool.get(), args.accum_path, args.crop, args.mask_path, out + ".ppm");
+
+        delete[] pBuffer;
+        delete[] pAlbedo;
+        delete[] pNormal;
+        return done ? 0 : 1;
+    }
+
+    // Frames are saved in the background while the next one renders.
+    output_writer writer;
+
+    // With a time budget, samples per pixel is only the upper limit; each
+    // frame is written with the count it reached.
+    const int sampleLimit = prefs.samples_per_pixel;
+    if (args.time_budget > 0 && args.mode == run_mode::coordinator)
+        std::cerr << "Warning: The time budget only applies to local rendering.\n";
+    auto render_local = [&](const camera& cam) {
+        prefs.samples_per_pixel = sampleLimit;
+        if (args.time_budget > 0)
+            prefs.samples_per_pixel = render_budgeted(cam, root, pool.get(), args.time_budget);
+        else
+            render_frame(cam, root, pool.get());
+    };
+
+    if (prefs.frames <= 1) {
+        if (args.mode == run_mode::coordinator)
+            render_distributed(view, args);
+        else
+            render_local(camera(view));
+
+        std::cerr << "Info: Writing output to file.\n";
+
+        write_frame(out, pool.get(), writer);
+    } else {
+        // Sequence: the scene, BVH and thread pool are reused for every frame.
+        animation anim;
+        if (read_animation("keyframes.cfg", world, anim))
+            std::cerr << std::format("Info: Loaded {} camera keys and {} object tracks from 'keyframes.cfg'.\n", anim.camera_keys.size(), anim.objects.size());
+        if (anim.camera_keys.empty())
+            anim.camera_keys = turntable(view.lookfrom, view.lookat, view.vfov, prefs.frames).camera_keys;
+        if (args.mode == run_mode::coordinator && !anim.objects.empty())
+            std::cerr << "Warning: Object tracks aren't sent to workers, only the camera is animated.\n";
+
+        for (int frame = 0; frame < prefs.frames; frame++) {
+            std::cerr << std::format("Info: Rendering frame {}/{}.\n", frame + 1, prefs.frames);
+
+            if (anim.apply(frame)) {
+                auto refitStart = std::chrono::steady_clock::now();
+                accelTask.get()->refit(pool.get());
+                if (grid)
+                    *grid = uniform_grid(world.objects);
+                auto refitTime  = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - refitStart);
+                std::cerr << std::format("Info: Refitted BVH in {}ms.\n", refitTime.count() / 1000.0);
+            }
+
+            auto          key    = anim.camera_at(frame);
+            camera_params params = view;
+            params.lookfrom = key.lookfrom;
+            params.lookat   = key.lookat;
+            params.vfov     = key.vfov;
+
+            if (args.mode == run_mode::coordinator)
+                render_distributed(params, args);
+            else
+                render_local(camera(params));
+
+            write_frame(std::format("{}_{:04}", out, frame), pool.get(), writer);
+        }
+    }
+
+    if (streamed)
+        std::cerr << std::format(
+            "Info: Scene file chunks: {} paged in, {} evicted, {} KiB peak resident.\n",
+            streamed->page_ins(),
+            streamed->evictions(),
+            streamed->peak_resident() / 1024
+        );
 
-    write_as_ppm(pBuffer, prefs, out_ppm.c_str());
-    //write_as_bmp(pBuffer, prefs, out_bmp.c_str());
-    
     delete[] pBuffer;
+    delete[] pAlbedo;
+    delete[] pNormal;
     return 0;
 }
\ No newline at end of file